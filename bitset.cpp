@@ -0,0 +1,249 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bitset.h"
+
+inline int word_count(int bits)
+{
+    return (bits + 63) / 64;
+}
+
+inline int bit_count(quint64 word)
+{
+    int count = 0;
+    while (word)
+    {
+        // Each step clears the lowest set bit
+        word &= word - 1;
+        ++count;
+    }
+    return count;
+}
+
+BitSet::BitSet() : m_size(0)
+{
+}
+
+BitSet::BitSet(int size) : m_words(word_count(size), 0), m_size(size)
+{
+}
+
+int BitSet::size() const
+{
+    return m_size;
+}
+
+void BitSet::resize(int size)
+{
+    // New words are zeroed, and the padding of the old last word is already clear
+    m_words.resize(word_count(size));
+    m_size = size;
+    clear_padding();
+}
+
+void BitSet::set(int i, bool on)
+{
+    Q_ASSERT(i >= 0 && i < m_size);
+    const quint64 mask = quint64(1) << (i % WordBits);
+    if (on)
+    {
+        m_words[i / WordBits] |= mask;
+    }
+    else
+    {
+        m_words[i / WordBits] &= ~mask;
+    }
+}
+
+void BitSet::toggle(int i)
+{
+    Q_ASSERT(i >= 0 && i < m_size);
+    m_words[i / WordBits] ^= quint64(1) << (i % WordBits);
+}
+
+void BitSet::set(const QVector<int>& indices, bool on)
+{
+    quint64* words = m_words.data();
+    foreach (int i, indices)
+    {
+        Q_ASSERT(i >= 0 && i < m_size);
+        const quint64 mask = quint64(1) << (i % WordBits);
+        if (on)
+        {
+            words[i / WordBits] |= mask;
+        }
+        else
+        {
+            words[i / WordBits] &= ~mask;
+        }
+    }
+}
+
+void BitSet::toggle(const QVector<int>& indices)
+{
+    quint64* words = m_words.data();
+    foreach (int i, indices)
+    {
+        Q_ASSERT(i >= 0 && i < m_size);
+        words[i / WordBits] ^= quint64(1) << (i % WordBits);
+    }
+}
+
+void BitSet::fill(bool on)
+{
+    m_words.fill(on ? ~quint64(0) : 0);
+    clear_padding();
+}
+
+void BitSet::unite(const BitSet& other)
+{
+    const int n = qMin(m_words.size(), other.m_words.size());
+    quint64* words = m_words.data();
+    const quint64* o = other.m_words.constData();
+    for (int w = 0; w < n; ++w)
+    {
+        words[w] |= o[w];
+    }
+    clear_padding();
+}
+
+void BitSet::subtract(const BitSet& other)
+{
+    const int n = qMin(m_words.size(), other.m_words.size());
+    quint64* words = m_words.data();
+    const quint64* o = other.m_words.constData();
+    for (int w = 0; w < n; ++w)
+    {
+        words[w] &= ~o[w];
+    }
+}
+
+void BitSet::intersect(const BitSet& other)
+{
+    const int n = qMin(m_words.size(), other.m_words.size());
+    quint64* words = m_words.data();
+    const quint64* o = other.m_words.constData();
+    for (int w = 0; w < n; ++w)
+    {
+        words[w] &= o[w];
+    }
+    for (int w = n; w < m_words.size(); ++w)
+    {
+        words[w] = 0;
+    }
+}
+
+void BitSet::toggle(const BitSet& other)
+{
+    const int n = qMin(m_words.size(), other.m_words.size());
+    quint64* words = m_words.data();
+    const quint64* o = other.m_words.constData();
+    for (int w = 0; w < n; ++w)
+    {
+        words[w] ^= o[w];
+    }
+    clear_padding();
+}
+
+int BitSet::count() const
+{
+    int count = 0;
+    foreach (quint64 word, m_words)
+    {
+        count += bit_count(word);
+    }
+    return count;
+}
+
+bool BitSet::any() const
+{
+    foreach (quint64 word, m_words)
+    {
+        if (word)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+QVector<int> BitSet::indices() const
+{
+    QVector<int> indices;
+    indices.reserve(count());
+    const int n = m_words.size();
+    for (int w = 0; w < n; ++w)
+    {
+        // Empty words are skipped whole, so sparse sets are fast to walk
+        quint64 word = m_words[w];
+        int i = w * WordBits;
+        while (word)
+        {
+            if (word & 1)
+            {
+                indices << i;
+            }
+            word >>= 1;
+            ++i;
+        }
+    }
+    return indices;
+}
+
+QVector< QPair<int, int> > BitSet::ranges() const
+{
+    QVector< QPair<int, int> > ranges;
+    const int n = m_words.size();
+    int first = -1;
+    for (int w = 0; w < n; ++w)
+    {
+        const quint64 word = m_words[w];
+        // Words that are all clear or all set cannot start or end a run in their middle
+        if ((word == 0 && first < 0) || (word == ~quint64(0) && first >= 0))
+        {
+            continue;
+        }
+        for (int b = 0; b < WordBits; ++b)
+        {
+            const bool on = (word >> b) & 1;
+            if (on && first < 0)
+            {
+                first = w * WordBits + b;
+            }
+            else if (!on && first >= 0)
+            {
+                ranges << qMakePair(first, w * WordBits + b);
+                first = -1;
+            }
+        }
+    }
+    if (first >= 0)
+    {
+        ranges << qMakePair(first, m_size);
+    }
+    return ranges;
+}
+
+void BitSet::clear_padding()
+{
+    // The bits past the end of the last word are always kept clear, so that whole words can be counted and compared
+    if (m_size % WordBits && !m_words.isEmpty())
+    {
+        m_words.last() &= (quint64(1) << (m_size % WordBits)) - 1;
+    }
+}
@@ -0,0 +1,87 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <QtCore/QVector>
+#include <QtCore/QPair>
+
+/**
+ * @brief A packed array of bits, with operations on whole sets done a word at a time
+ *
+ * Used for the selection and marking state of batched curves. Clearing, moving or combining
+ * the state of a million points only touches about sixteen thousand words.
+ **/
+class BitSet
+{
+public:
+    BitSet();
+    explicit BitSet(int size);
+
+    int size() const;
+    void resize(int size);
+
+    inline bool test(int i) const
+    {
+        Q_ASSERT(i >= 0 && i < m_size);
+        return (m_words[i / WordBits] >> (i % WordBits)) & 1;
+    }
+
+    void set(int i, bool on = true);
+    void toggle(int i);
+    void set(const QVector<int>& indices, bool on = true);
+    void toggle(const QVector<int>& indices);
+
+    /**
+     * Sets or clears all the bits
+     **/
+    void fill(bool on);
+
+    void unite(const BitSet& other);
+    void subtract(const BitSet& other);
+    void intersect(const BitSet& other);
+    
+    /**
+     * Flips the bits that are set in @p other, so that comparing with a snapshot leaves only the changed bits
+     **/
+    void toggle(const BitSet& other);
+
+    int count() const;
+    bool any() const;
+
+    /**
+     * @return the indices of the bits that are set, in increasing order
+     **/
+    QVector<int> indices() const;
+    
+    /**
+     * @return the runs of set bits, each as a pair of its first index and one past its last index
+     **/
+    QVector< QPair<int, int> > ranges() const;
+
+private:
+    enum { WordBits = 64 };
+
+    void clear_padding();
+
+    QVector<quint64> m_words;
+    int m_size;
+};
+
+#endif // BITSET_H
@@ -25,6 +25,7 @@
 #include <QtCore/qmath.h>
 #include <QtCore/QtConcurrentRun>
 #include <QtCore/QFutureWatcher>
+#include <QtCore/QSet>
 
 #include "point.h"
 #include "plot.h"
@@ -42,9 +43,15 @@ Curve::Curve(const QList< double >& x_data, const QList< double >& y_data, QGrap
     m_continuous = false;
     m_needsUpdate = UpdateAll;
     m_lineItem = new QGraphicsPathItem(this);
+    m_render_mode = RenderItems;
+    m_scatter_item = 0;
+    m_pyramid_enabled = false;
+    m_update_scheduled = false;
+    m_generation = 0;
+    m_pos_generation = 0;
     set_data(x_data, y_data);
     QObject::connect(&m_pos_watcher, SIGNAL(finished()), SLOT(pointMapFinished()));
-    QObject::connect(&m_coords_watcher, SIGNAL(finished()), SLOT(update_point_positions()));
+    QObject::connect(&m_sprite_watcher, SIGNAL(finished()), SLOT(spritesFinished()));
     m_autoUpdate = true;
     m_segmentLength = 0;
 }
@@ -55,9 +62,15 @@ Curve::Curve(QGraphicsItem* parent): PlotItem(parent)
     m_autoUpdate = true;
     m_style = Points;
     m_lineItem = new QGraphicsPathItem(this);
+    m_render_mode = RenderItems;
+    m_scatter_item = 0;
+    m_pyramid_enabled = false;
+    m_update_scheduled = false;
+    m_generation = 0;
+    m_pos_generation = 0;
     m_needsUpdate = 0;
     QObject::connect(&m_pos_watcher, SIGNAL(finished()), SLOT(pointMapFinished()));
-    QObject::connect(&m_coords_watcher, SIGNAL(finished()), SLOT(update_point_positions()));
+    QObject::connect(&m_sprite_watcher, SIGNAL(finished()), SLOT(spritesFinished()));
     m_segmentLength = 0;
 }
 
@@ -69,16 +82,20 @@ Curve::~Curve()
 
 void Curve::update_number_of_items()
 {
-  cancel_all_updates();
-  if (m_continuous || (m_data.size() == m_pointItems.size()))
+  if (m_continuous || m_render_mode != RenderItems || (m_data.size() == m_pointItems.size()))
   {
     m_needsUpdate &= ~UpdateNumberOfItems;
     return;
   }
   if (m_pointItems.size() != m_data.size())
   {
+    // Only a change in the number of items makes the running updates useless
+    cancel_all_updates();
     resize_item_list<Point>(m_pointItems, m_data.size());
     register_points();
+    apply_draw_order();
+    // New items are at the origin until they get their positions
+    set_dirty(UpdatePosition);
   }
   Q_ASSERT(m_pointItems.size() == m_data.size());
 }
@@ -87,30 +104,8 @@ void Curve::update_properties()
 {
   cancel_all_updates();
 
-  bool lines = false;
-  bool points = false;
-  
-  switch (m_style)
-  {
-      case Points:
-          points = true;
-          break;
-          
-      case Lines:
-      case Dots:
-          lines = true;
-          break;
-          
-      case LinesPoints:
-          lines = true;
-          points = true;
-          break;
-          
-      default:
-          lines = m_continuous;
-          points = !m_continuous;
-          break;
-  }
+  const bool lines = shows_lines();
+  const bool points = shows_points();
 
   m_lineItem->setVisible(lines);
   
@@ -120,10 +115,30 @@ void Curve::update_properties()
     p.setCosmetic(true);
     p.setStyle((Qt::PenStyle)m_style);
     m_lineItem->setPen(p);
-    m_lineItem->setPath(continuous_path());
+    update_line_path(0);
   } 
   
-  if (points)
+  if (m_scatter_item)
+  {
+    m_scatter_item->setVisible(points);
+  }
+  
+  if (points && m_render_mode != RenderItems)
+  {
+    if (!m_pointItems.isEmpty())
+    {
+        qDeleteAll(m_pointItems);
+        m_pointItems.clear();
+        register_points();
+    }
+    if (!m_scatter_item)
+    {
+        m_scatter_item = new ScatterItem(this);
+    }
+    m_scatter_item->update_geometry();
+    m_needsUpdate = 0;
+  }
+  else if (points)
   {
     
     if (m_pointItems.size() != m_data.size())
@@ -147,6 +162,42 @@ void Curve::update_properties()
   {
       qDeleteAll(m_pointItems);
       m_pointItems.clear();
+      register_points();
+      m_needsUpdate = 0;
+  }
+}
+
+bool Curve::shows_lines() const
+{
+  switch (m_style)
+  {
+      case Points:
+          return false;
+          
+      case Lines:
+      case Dots:
+      case LinesPoints:
+          return true;
+          
+      default:
+          return m_continuous;
+  }
+}
+
+bool Curve::shows_points() const
+{
+  switch (m_style)
+  {
+      case Points:
+      case LinesPoints:
+          return true;
+          
+      case Lines:
+      case Dots:
+          return false;
+          
+      default:
+          return !m_continuous;
   }
 }
 
@@ -167,6 +218,18 @@ Point* Curve::point_item(double x, double y, int size, QGraphicsItem* parent)
 
 Data Curve::data() const
 {
+  return m_data.to_data();
+}
+
+const CurveData& Curve::curve_data() const
+{
+  return m_data;
+}
+
+CurveData& Curve::mutable_curve_data()
+{
+  // The data may be changed in any way, so the pyramid has to be rebuilt
+  m_pyramid.clear();
   return m_data;
 }
 
@@ -175,24 +238,133 @@ void Curve::set_data(const QList< double > x_data, const QList< double > y_data)
   Q_ASSERT(x_data.size() == y_data.size());
   int n = qMin(x_data.size(), y_data.size());
   qDebug() << "Curve::set_data with" << n << "points";
-  if (n != m_data.size())
+  const int previous_size = m_data.size();
+  m_data.set_data(x_data, y_data);
+  data_changed(previous_size);
+}
+
+void Curve::set_data(const CurveColumn& x_data, const CurveColumn& y_data)
+{
+  Q_ASSERT(x_data.size == y_data.size);
+  const int previous_size = m_data.size();
+  m_data.set_data(x_data, y_data);
+  data_changed(previous_size);
+}
+
+void Curve::append_data(const QList< double > x_data, const QList< double > y_data)
+{
+  const int previous_size = m_data.size();
+  m_data.append(x_data, y_data);
+  m_data.fill_styles(m_color, m_pointSize, m_symbol);
+  data_appended(previous_size);
+}
+
+void Curve::append_data(const CurveColumn& x_data, const CurveColumn& y_data)
+{
+  const int previous_size = m_data.size();
+  m_data.append(x_data, y_data);
+  m_data.fill_styles(m_color, m_pointSize, m_symbol);
+  data_appended(previous_size);
+}
+
+void Curve::data_appended(int previous_size)
+{
+  const int n = m_data.size();
+  if (n == previous_size)
   {
-    m_needsUpdate |= UpdateNumberOfItems;
+    return;
+  }
+  
+  if (m_pyramid.is_built())
+  {
+    m_pyramid.extend(m_data, previous_size);
+  }
+  
+  const QRectF added = m_data.bounding_rect(previous_size);
+  if (previous_size == 0)
+  {
+    set_data_rect(added);
+  }
+  else
+  {
+    // QRectF::united() ignores empty rects, which are valid here (for example, a single point)
+    const QRectF r = data_rect();
+    set_data_rect(QRectF(QPointF(qMin(r.left(), added.left()), qMin(r.top(), added.top())), 
+                         QPointF(qMax(r.right(), added.right()), qMax(r.bottom(), added.bottom()))));
+  }
+  
+  if (!m_autoUpdate || (m_needsUpdate & (UpdateNumberOfItems | UpdatePosition)) || is_updating())
+  {
+    // The existing points are not in their final state yet, so update everything
+    m_needsUpdate |= UpdateNumberOfItems | UpdatePosition;
+    checkForUpdate();
+    return;
+  }
+  
+  if (shows_lines())
+  {
+    update_line_path(previous_size);
+  }
+  
+  if (!shows_points())
+  {
+    return;
   }
-  m_data.clear();
+  
+  if (m_render_mode != RenderItems)
+  {
+    if (m_scatter_item)
+    {
+      m_scatter_item->update_geometry();
+    }
+    return;
+  }
+  
+  // Only the new points are created and positioned
+  resize_item_list<Point>(m_pointItems, n);
+  PointUpdater updater(m_symbol, m_color, m_pointSize, Point::DisplayPath);
+  for (int i = previous_size; i < n; ++i)
+  {
+    Point* point = m_pointItems[i];
+    updater(point);
+    point->set_coordinates(m_data.data_point(i));
+    point->setPos(m_graphTransform.map(m_data.point(i)));
+  }
+  
+  Plot* p = plot();
+  if (p)
+  {
+    p->add_points(m_pointItems, m_data, this, previous_size);
+  }
+}
 
-#if QT_VERSION >= 0x040700
-  m_data.reserve(n);
-#endif
+void Curve::update_line_path(int first)
+{
+  if (first == 0 || uses_pyramid())
+  {
+    m_lineItem->setPath(continuous_path());
+    return;
+  }
+  
+  // Continue the existing path instead of rebuilding it
+  QPainterPath path = m_lineItem->path();
+  add_decimated_path(path, first, m_data.size());
+  m_lineItem->setPath(path);
+}
+
+bool Curve::is_updating() const
+{
+  return m_pos_watcher.isRunning();
+}
 
-  for (int i = 0; i < n; ++i)
+void Curve::data_changed(int previous_size)
+{
+  m_pyramid.clear();
+  if (m_data.size() != previous_size)
   {
-    DataPoint p;
-    p.x = x_data[i];
-    p.y = y_data[i];
-    m_data.append(p);
+    m_needsUpdate |= UpdateNumberOfItems;
   }
-  set_data_rect(rect_from_data(x_data, y_data));
+  set_data_rect(m_data.bounding_rect());
   m_needsUpdate |= UpdatePosition;
   checkForUpdate();
 }
@@ -322,6 +494,26 @@ void Curve::set_segment_length(int length)
     checkForUpdate();
 }
 
+bool Curve::pyramid_enabled() const
+{
+    return m_pyramid_enabled;
+}
+
+void Curve::set_pyramid_enabled(bool enabled)
+{
+    if (enabled == m_pyramid_enabled)
+    {
+        return;
+    }
+    m_pyramid_enabled = enabled;
+    if (!enabled)
+    {
+        m_pyramid.clear();
+    }
+    m_needsUpdate |= UpdateZoom;
+    checkForUpdate();
+}
+
 bool Curve::auto_update() const
 {
   return m_autoUpdate;
@@ -335,6 +527,17 @@ void Curve::set_auto_update(bool auto_update)
 
 void Curve::checkForUpdate()
 {
+  if ( m_autoUpdate && m_needsUpdate && !m_update_scheduled )
+  {
+    // Several properties are usually set in a row, so they are all applied in a single update
+    m_update_scheduled = true;
+    QMetaObject::invokeMethod(this, "flush_updates", Qt::QueuedConnection);
+  }
+}
+
+void Curve::flush_updates()
+{
+  m_update_scheduled = false;
   if ( m_autoUpdate && m_needsUpdate )
   {
     update_properties();
@@ -380,33 +583,15 @@ QTransform Curve::zoom_transform()
 
 void Curve::cancel_all_updates()
 {
-    QMap<UpdateFlag, QFuture< void > >::iterator it = m_currentUpdate.begin();
-    QMap<UpdateFlag, QFuture< void > >::iterator end = m_currentUpdate.end();
-    for (it; it != end; ++it)
-    {
-        if (it.value().isRunning())
-        {
-            it.value().cancel();
-        }
-    }
-    for (it = m_currentUpdate.begin(); it != end; ++it)
+    // Background updates only work on their own copies of the data, so there is no need to wait for them
+    ++m_generation;
+    if (m_pos_watcher.isRunning())
     {
-        if (it.value().isRunning())
-        {
-            it.value().waitForFinished();
-        }
+        *m_pos_token = 1;
+        m_pos_watcher.cancel();
+        // The items still need their positions, so they are computed again with the next update
+        m_needsUpdate |= UpdatePosition;
     }
-    m_currentUpdate.clear();
-    
-    m_coords_watcher.blockSignals(true);
-    m_coords_watcher.cancel();
-    m_coords_watcher.waitForFinished();
-    m_coords_watcher.blockSignals(false);
-    
-    m_pos_watcher.blockSignals(true);
-    m_pos_watcher.cancel();
-    m_pos_watcher.waitForFinished();
-    m_pos_watcher.blockSignals(false);
 }
 
 void Curve::register_points()
@@ -415,7 +600,15 @@ void Curve::register_points()
     if (p)
     {
         p->remove_all_points(this);
-        p->add_points(m_pointItems, this);
+        if (m_pointItems.size() == m_data.size())
+        {
+            // The points' own coordinates may not be set yet, so we take them from the data
+            p->add_points(m_pointItems, m_data, this);
+        }
+        else
+        {
+            p->add_points(m_pointItems, this);
+        }
     }
 }
 
@@ -437,10 +630,12 @@ void Curve::set_points(const QList< Point* >& points)
     }
     m_pointItems = points;
     register_points();
+    apply_draw_order();
 }
 
 QList< Point* > Curve::points()
 {
+    flush_updates();
     return m_pointItems;
 }
 
@@ -454,83 +649,278 @@ bool Curve::labels_on_marked()
 	return m_labels_on_marked;
 }
 
-void Curve::update_point_coordinates()
+int Curve::render_mode() const
 {
-    if (m_coords_watcher.isRunning())
+    return m_render_mode;
+}
+
+void Curve::set_render_mode(int mode)
+{
+    if (mode == m_render_mode)
+    {
+        return;
+    }
+    m_render_mode = mode;
+    if (m_render_mode == RenderItems && m_scatter_item)
+    {
+        delete m_scatter_item;
+        m_scatter_item = 0;
+    }
+    m_needsUpdate |= UpdateAll;
+    checkForUpdate();
+}
+
+ScatterItem* Curve::scatter_item() const
+{
+    return m_scatter_item;
+}
+
+const QVector<int>& Curve::draw_order() const
+{
+    return m_draw_order;
+}
+
+void Curve::apply_draw_order()
+{
+    const int n = m_draw_order.size();
+    if (m_render_mode == RenderItems && m_pointItems.size() == n)
     {
-        m_coords_watcher.blockSignals(true);
-        m_coords_watcher.cancel();
-        m_coords_watcher.waitForFinished();
-        m_coords_watcher.blockSignals(false);
+        for (int k = 0; k < n; ++k)
+        {
+            m_pointItems[m_draw_order[k]]->setZValue(1.0 * k / n);
+        }
     }
-    m_coords_watcher.setFuture(QtConcurrent::run(this, &Curve::update_point_properties_threaded<DataPoint>, QByteArray("coordinates"), m_data));
+}
+
+QVector<int> Curve::selected_indices()
+{
+    return indices_with(Point::Selected);
+}
+
+QVector<int> Curve::marked_indices()
+{
+    return indices_with(Point::Marked);
+}
+
+int Curve::index_of(Point* point)
+{
+    // The cached numbers are checked against the list, so they are rebuilt only after the items change
+    const int i = m_point_numbers.value(point, -1);
+    if (i >= 0 && i < m_pointItems.size() && m_pointItems[i] == point)
+    {
+        return i;
+    }
+    m_point_numbers.clear();
+    const int n = m_pointItems.size();
+    m_point_numbers.reserve(n);
+    for (int j = 0; j < n; ++j)
+    {
+        m_point_numbers.insert(m_pointItems[j], j);
+    }
+    return m_point_numbers.value(point, -1);
+}
+
+QVector<int> Curve::indices_with(Point::StateFlag flag)
+{
+    flush_updates();
+    if (m_scatter_item)
+    {
+        return m_scatter_item->indices_with(flag);
+    }
+    QVector<int> indices;
+    const int n = m_pointItems.size();
+    for (int i = 0; i < n; ++i)
+    {
+        if (m_pointItems[i]->state_flag(flag))
+        {
+            indices << i;
+        }
+    }
+    return indices;
+}
+
+void Curve::set_draw_order(const QVector<int>& order)
+{
+    // Pending updates may still create the point items, so they are applied first
+    flush_updates();
+    m_draw_order = order;
+    apply_draw_order();
+    if (m_scatter_item)
+    {
+        m_scatter_item->update_geometry();
+    }
+}
+
+void Curve::update_point_coordinates()
+{
+    start_position_update(m_data, QVector<DataPoint>());
 }
 
 void Curve::update_point_positions()
+{
+    if (m_pointItems.isEmpty())
+    {
+        return;
+    }
+    
+    // The workers must not read the items, so they get a copy of the coordinates
+    const int n = m_pointItems.size();
+    QVector<DataPoint> coordinates(n);
+    for (int i = 0; i < n; ++i)
+    {
+        coordinates[i] = m_pointItems[i]->coordinates();
+    }
+    start_position_update(CurveData(), coordinates);
+}
+
+void Curve::start_position_update(const CurveData& data, const QVector<DataPoint>& coordinates)
 {
     if (m_pos_watcher.isRunning())
     {
-        m_pos_watcher.blockSignals(true);
+        *m_pos_token = 1;
         m_pos_watcher.cancel();
-        m_pos_watcher.waitForFinished();
-        m_pos_watcher.blockSignals(false);
     }
-    if (m_pointItems.isEmpty())
+    m_pos_token = UpdateToken(new QAtomicInt(0));
+    m_pos_data = data;
+    m_pos_generation = m_generation;
+    m_pos_watcher.setFuture(QtConcurrent::run(&Curve::map_positions, data, coordinates, m_graphTransform, m_pos_token));
+}
+
+QVector<QPointF> Curve::map_positions(const CurveData& data, const QVector<DataPoint>& coordinates, const QTransform& transform, const UpdateToken& token)
+{
+    const int n = data.is_empty() ? coordinates.size() : data.size();
+    QVector<QPointF> positions(n);
+    
+    // Each range writes to its own part of the result, so they can be computed in parallel
+    const int chunk_size = 4096;
+    QList< QPair<int, int> > ranges;
+    for (int first = 0; first < n; first += chunk_size)
     {
-        return;
+        ranges << qMakePair(first, qMin(first + chunk_size, n));
     }
-    if (use_animations())
+    QtConcurrent::blockingMap(ranges, PointPosMapper(data, coordinates, transform, positions.data(), token));
+    return positions;
+}
+
+void Curve::prewarm_sprites()
+{
+    // Only the combinations that are actually used are rendered, not every symbol with every color
+    QSet<PointData> keys;
+    const int n = m_data.size();
+    if (m_data.has_colors() || m_data.has_sizes() || m_data.has_symbols())
     {
-        m_pos_watcher.setFuture(QtConcurrent::mapped(m_pointItems, PointPosMapper(m_graphTransform)));
+        for (int i = 0; i < n; ++i)
+        {
+            keys << PointData(m_data.size_at(i, m_pointSize), m_data.symbol(i, m_symbol), m_data.color(i, m_color), Point::Normal, true);
+        }
     }
-    else
+    else if (n > 0)
     {
-        update_items(m_pointItems, PointPosUpdater(m_graphTransform), UpdatePosition);
+        keys << PointData(m_pointSize, m_symbol, m_color, Point::Normal, true);
     }
+    
+    m_sprite_keys.clear();
+    foreach (const PointData& key, keys)
+    {
+        if (!Point::pixmap_cache.contains(key))
+        {
+            m_sprite_keys << key;
+        }
+    }
+    if (m_sprite_keys.isEmpty())
+    {
+        return;
+    }
+    m_sprite_watcher.setFuture(QtConcurrent::run(&Point::render_sprites, m_sprite_keys));
+}
+
+void Curve::spritesFinished()
+{
+    const QList<QImage> images = m_sprite_watcher.result();
+    const int n = qMin(images.size(), m_sprite_keys.size());
+    for (int i = 0; i < n; ++i)
+    {
+        Point::insert_sprite(m_sprite_keys[i], images[i]);
+    }
+    m_sprite_keys.clear();
 }
 
 void Curve::pointMapFinished()
 {
-    if (m_pointItems.size() != m_pos_watcher.future().results().size())
+    if (m_pos_generation != m_generation || m_pos_watcher.isCanceled())
     {
         // The calculation that just finished is already out of date, ignore it
         return;
     }
-    QParallelAnimationGroup* group = new QParallelAnimationGroup(this);
-    int n = m_pointItems.size();
+    const QVector<QPointF> positions = m_pos_watcher.result();
+    const int n = m_pointItems.size();
+    if (positions.size() != n)
+    {
+        return;
+    }
+    
+    // The items are only changed here, on the GUI thread
+    if (!m_pos_data.is_empty())
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            m_pointItems[i]->set_coordinates(m_pos_data.data_point(i));
+        }
+        m_pos_data = CurveData();
+    }
+    
+    const bool animate = use_animations();
+    QParallelAnimationGroup* group = animate ? new QParallelAnimationGroup(this) : 0;
     for (int i = 0; i < n; ++i)
     {
+        Point* point = m_pointItems[i];
+        const QPointF& pos = positions[i];
         /* 
          * If a point was just created, its position is (0,0)
          * In this case, animating it would create more confusion that good
          * So we just move it without an animation. 
          * This is the case (for example) for the anchor curve in RadViz
          */
-        if (m_pointItems[i]->pos().isNull())
+        if (!animate || point->pos().isNull())
         {
-            m_pointItems[i]->setPos(m_pos_watcher.resultAt(i));
+            point->setPos(pos);
             // move point label
-            if (m_pointItems[i]->label)
-			{
-            	m_pointItems[i]->label->setPos(m_pos_watcher.resultAt(i));
-			}
+            if (point->label)
+            {
+                point->label->setPos(pos);
+            }
         }
         else
         {
-            QPropertyAnimation* a = new QPropertyAnimation(m_pointItems[i], "pos", m_pointItems[i]);
-            a->setEndValue(m_pos_watcher.resultAt(i));
+            QPropertyAnimation* a = new QPropertyAnimation(point, "pos", point);
+            a->setEndValue(pos);
             group->addAnimation(a);
 
             // move point label
-            if (m_pointItems[i]->label)
+            if (point->label)
             {
-				QPropertyAnimation* b = new QPropertyAnimation(m_pointItems[i]->label, "pos", m_pointItems[i]->label);
-				b->setEndValue(m_pos_watcher.resultAt(i));
-				group->addAnimation(b);
+                QPropertyAnimation* b = new QPropertyAnimation(point->label, "pos", point->label);
+                b->setEndValue(pos);
+                group->addAnimation(b);
             }
         }
     }
-    group->start(QAbstractAnimation::DeleteWhenStopped);
+    if (group)
+    {
+        // The hover index is rebuilt once the points reach their new positions
+        QObject::connect(group, SIGNAL(finished()), SLOT(pointsMoved()));
+        group->start(QAbstractAnimation::DeleteWhenStopped);
+    }
+    pointsMoved();
+}
+
+void Curve::pointsMoved()
+{
+    Plot* p = plot();
+    if (p)
+    {
+        p->invalidate_point_index(this);
+    }
 }
 
 bool Curve::use_animations()
@@ -554,29 +944,127 @@ void Curve::update_point_properties_same(const QByteArray& property, const QVari
     }
     else
     {
-        m_property_updates[property] = QtConcurrent::map(m_pointItems, PointPropertyUpdater(property, value));
+        update_items(m_pointItems, PointPropertyUpdater(property, value), UpdateAll);
     }
 }
 
 QPainterPath Curve::continuous_path()
+{
+    if (uses_pyramid())
+    {
+        return pyramid_path();
+    }
+    QPainterPath path;
+    add_decimated_path(path, 0, m_data.size());
+    return path;
+}
+
+bool Curve::uses_pyramid()
+{
+    if (!m_pyramid_enabled || m_segmentLength || !plot())
+    {
+        return false;
+    }
+    if (!m_pyramid.is_built())
+    {
+        m_pyramid.build(m_data);
+    }
+    return m_pyramid.is_valid();
+}
+
+QPainterPath Curve::pyramid_path()
 {
     QPainterPath path;
-    if (m_data.isEmpty())
+    const int n = m_data.size();
+    bool ok;
+    const QTransform device = m_graphTransform * m_zoom_transform;
+    const QTransform inverse = device.inverted(&ok);
+    if (n == 0 || !ok)
     {
         return path;
     }
-    path.moveTo(m_data[0]);
-    int n = m_data.size();
-    QPointF p;
-    for (int i = 1; i < n; ++i)
+    
+    // Only the visible range, plus one point on each side, is part of the path
+    const QRectF graph_rect = plot()->graph_rect();
+    const QRectF visible = inverse.mapRect(graph_rect);
+    const double* x = m_data.x_data();
+    const int first = qMax(0, int(qLowerBound(x, x + n, visible.left()) - x) - 1);
+    const int last = qMin(n, int(qUpperBound(x, x + n, visible.right()) - x) + 1);
+    
+    const int level = m_pyramid.level_for(last - first, graph_rect.width());
+    if (level == 0)
+    {
+        add_decimated_path(path, first, last);
+    }
+    else
+    {
+        m_pyramid.add_path(path, m_data, m_graphTransform, level, first, last);
+    }
+    return path;
+}
+
+void Curve::add_decimated_path(QPainterPath& path, int first, int last)
+{
+    /*
+     * Consecutive points that fall into the same pixel column are drawn as a vertical line
+     * from the lowest to the highest one, so only the first, last, lowest and highest point
+     * of each such run affect the picture. The path gets at most four elements per column.
+     */
+    const QTransform device = m_graphTransform * m_zoom_transform;
+    int i = first;
+    while (i < last)
     {
-        if (m_segmentLength && (i % (m_segmentLength) == 0)) {
-            path.moveTo(m_data[i]);
-        } else {
-            path.lineTo(m_data[i]);
+        const QPointF start = device.map(m_data.point(i));
+        const double column = floor(start.x());
+        int end = i;
+        int lowest = i;
+        int highest = i;
+        double low = start.y();
+        double high = start.y();
+        for (int j = i + 1; j < last; ++j)
+        {
+            if (m_segmentLength && (j % m_segmentLength == 0))
+            {
+                break;
+            }
+            const QPointF p = device.map(m_data.point(j));
+            if (floor(p.x()) != column)
+            {
+                break;
+            }
+            end = j;
+            if (p.y() < low)
+            {
+                low = p.y();
+                lowest = j;
+            }
+            if (p.y() > high)
+            {
+                high = p.y();
+                highest = j;
+            }
+        }
+
+        int kept[4] = {i, qMin(lowest, highest), qMax(lowest, highest), end};
+        for (int k = 0; k < 4; ++k)
+        {
+            if (k > 0 && kept[k] == kept[k-1])
+            {
+                continue;
+            }
+            const int index = kept[k];
+            const QPointF p = m_graphTransform.map(m_data.point(index));
+            if (k == 0 && (index == 0 || path.elementCount() == 0 || (m_segmentLength && (index % m_segmentLength == 0))))
+            {
+                path.moveTo(p);
+            }
+            else
+            {
+                path.lineTo(p);
+            }
         }
+        i = end + 1;
     }
-    return m_graphTransform.map(path);
 }
 
 #include "curve.moc"
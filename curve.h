@@ -21,6 +21,9 @@
 
 #include "plotitem.h"
 #include "point.h"
+#include "curvedata.h"
+#include "scatteritem.h"
+#include "minmaxpyramid.h"
 
 #include <QtGui/QPen>
 #include <QtGui/QBrush>
@@ -28,17 +31,57 @@
 #include <QtCore/QFutureWatcher>
 #include <QtCore/QParallelAnimationGroup>
 #include <QtCore/QtConcurrentRun>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QHash>
 
-struct PointPosMapper{
-  PointPosMapper(const QTransform& t) : t(t) {}
-  typedef QPointF result_type;
-  result_type operator()(Point* p)
+/**
+ * @brief Set by the curve when a background update is superseded
+ * 
+ * Background updates check it regularly, so a cancelled update stops soon 
+ * and the curve never has to wait for it. 
+ **/
+typedef QSharedPointer<QAtomicInt> UpdateToken;
+
+/**
+ * @brief Computes the positions of a range of points
+ * 
+ * The coordinates are taken from @c data if it is not empty, and from @c coordinates otherwise. 
+ * The mapper only reads its own copies and writes to its own part of @c positions, 
+ * so several ranges can be computed in parallel without touching any items. 
+ **/
+struct PointPosMapper
+{
+  PointPosMapper(const CurveData& data, const QVector<DataPoint>& coordinates, const QTransform& t, QPointF* positions, const UpdateToken& token) 
+  : data(data), coordinates(coordinates), t(t), positions(positions), token(token) {}
+  
+  void operator()(const QPair<int, int>& range)
   {
-    return t.map(p->coordinates());
+    if (*token != 0)
+    {
+      return;
+    }
+    if (data.is_empty())
+    {
+      for (int i = range.first; i < range.second; ++i)
+      {
+        positions[i] = t.map(QPointF(coordinates[i].x, coordinates[i].y));
+      }
+    }
+    else
+    {
+      for (int i = range.first; i < range.second; ++i)
+      {
+        positions[i] = t.map(data.point(i));
+      }
+    }
   }
   
 private:
+    CurveData data;
+    QVector<DataPoint> coordinates;
     QTransform t;
+    QPointF* positions;
+    UpdateToken token;
 };
 
 struct PointUpdater
@@ -90,8 +133,6 @@ struct Updater
     QBrush m_brush;
     QPainterPath m_path;
 };
-  
-typedef QList< DataPoint > Data;
 
 class Curve : public PlotItem
 {
@@ -108,6 +149,21 @@ public:
     UserCurve = 100
   };
   
+  /**
+   * @brief How the points of the curve are drawn
+   * 
+   * With RenderItems, every data point is a separate Point item. 
+   * With RenderBatched, a single ScatterItem draws all the points, which scales to much larger data sets. 
+   * RenderTiled also uses a ScatterItem, but rasterizes the points into tiles on worker threads. 
+   * RenderDensity draws the number of points in each pixel instead of the points, for curves with millions of points. 
+   **/
+  enum RenderMode {
+    RenderItems,
+    RenderBatched,
+    RenderTiled,
+    RenderDensity
+  };
+  
   /**
    * @brief Default constructor
    * 
@@ -156,10 +212,43 @@ public:
 
   int segment_length() const;
   void set_segment_length(int length);
+  
+  /**
+   * @brief Draw the line from a min/max pyramid
+   * 
+   * If enabled and the x coordinates are sorted, the line only covers the visible range, 
+   * and uses the pyramid level with about one bucket per pixel, so zooming and panning cost 
+   * about the same regardless of the number of points. 
+   * The pyramid is not used for curves with a segment length. 
+   **/
+  bool pyramid_enabled() const;
+  void set_pyramid_enabled(bool enabled);
 
   Data data() const;
   void set_data(const QList<double> x_data, const QList<double> y_data);
   
+  /**
+   * @brief Set the data without converting it element by element
+   * 
+   * If the columns borrow their values from an external buffer, such as a numpy array, 
+   * the curve reads the buffer in place and keeps it alive for as long as it needs it. 
+   **/
+  void set_data(const CurveColumn& x_data, const CurveColumn& y_data);
+  
+  /**
+   * @brief Add data points to the end of the curve
+   * 
+   * Unlike set_data(), only the new points are created and positioned, and the data rect 
+   * is extended instead of recomputed, so the cost depends on the number of new points. 
+   **/
+  void append_data(const QList<double> x_data, const QList<double> y_data);
+  void append_data(const CurveColumn& x_data, const CurveColumn& y_data);
+  
+  /**
+   * @return the columnar point store this curve reads its coordinates and per-point styles from
+   **/
+  const CurveData& curve_data() const;
+  
   virtual QTransform graph_transform() const;
   virtual void set_graph_transform(const QTransform& transform);
   virtual void register_points();
@@ -176,6 +265,12 @@ public:
   QTransform zoom_transform();
   virtual void set_zoom_transform(const QTransform& transform);
   
+  /**
+   * @brief The line through all the points, in graph coordinates
+   * 
+   * Points that are drawn into the same pixel column at the current zoom level are reduced to 
+   * the first, last, lowest and highest one, so the path has at most four elements per column.
+   **/
   QPainterPath continuous_path();
 
   enum UpdateFlag
@@ -201,9 +296,6 @@ public:
   template <class T>
   void update_point_properties(const QByteArray& property, const QList< T >& values, bool animate = true);
 
-  template <class T>
-  void update_point_properties_threaded(const QByteArray& property, const QList<T>& values);
-  
   void update_point_properties_same(const QByteArray& property, const QVariant& value, bool animate);
   
   template <class T>
@@ -214,14 +306,54 @@ public:
   
   bool labels_on_marked();
   void set_labels_on_marked(bool value);
-
-  QMap<UpdateFlag, QFuture<void> > m_currentUpdate;
+  
+  int render_mode() const;
+  void set_render_mode(int mode);
+  
+  /**
+   * @return the item that draws the points in the RenderBatched, RenderTiled and RenderDensity modes, or 0 in RenderItems mode
+   **/
+  ScatterItem* scatter_item() const;
+  
+  /**
+   * @brief The order in which the points are drawn, as a permutation of their indices
+   * 
+   * Later points in the order are drawn on top. The batched renderers follow it directly, 
+   * while in RenderItems mode it is applied as the items' z values. 
+   * If the order is empty or does not match the number of points, they are drawn in their natural order. 
+   **/
+  const QVector<int>& draw_order() const;
+  void set_draw_order(const QVector<int>& order);
+  
+  /**
+   * @return the indices of the selected or marked points, in increasing order
+   **/
+  QVector<int> selected_indices();
+  QVector<int> marked_indices();
+  
+  /**
+   * @return the position of @p point in points(), or -1 if it is not one of this curve's points
+   **/
+  int index_of(Point* point);
+  
+  /**
+   * @brief Renders the sprites for this curve's points in the background
+   * 
+   * Every combination of symbol, color and size that the points use is rendered on a worker thread, 
+   * and added to the sprite cache when done, so that the first paint does not have to render them. 
+   * Call this after setting the data and style, but before the curve is shown. 
+   **/
+  void prewarm_sprites();
 
 protected:
   Curve::UpdateFlags needs_update();
   void set_updated(Curve::UpdateFlags flags);
   
+  /**
+   * Cancels all background updates without waiting for them. Their results are discarded. 
+   **/
   void cancel_all_updates();
+  
   void update_number_of_items();
   
   void checkForUpdate();
@@ -229,58 +361,111 @@ protected:
   
   bool use_animations();
   
+  CurveData& mutable_curve_data();
+  void data_changed(int previous_size);
+  void data_appended(int previous_size);
+  
+  bool shows_lines() const;
+  bool shows_points() const;
+  bool is_updating() const;
+  
+  /**
+   * Updates the line connecting the points. 
+   * If @p first is 0, the whole line is rebuilt, otherwise points from @p first onward were appended. 
+   **/
+  virtual void update_line_path(int first);
+  
 public slots:
     void update_point_coordinates();
     void update_point_positions();
+    
+    /**
+     * @brief Runs the scheduled update now, if there is one
+     * 
+     * Setters only record what needs to be updated and schedule a single update_properties() 
+     * for the next pass of the event loop. Call this if you need the items updated before that. 
+     **/
+    void flush_updates();
   
 private slots:
     void pointMapFinished();
+    void spritesFinished();
+    void pointsMoved();
 
 private:
+  void start_position_update(const CurveData& data, const QVector<DataPoint>& coordinates);
+  static QVector<QPointF> map_positions(const CurveData& data, const QVector<DataPoint>& coordinates, const QTransform& transform, const UpdateToken& token);
+  void add_decimated_path(QPainterPath& path, int first, int last);
+  bool uses_pyramid();
+  QVector<int> indices_with(Point::StateFlag flag);
+  
+  /**
+   * Sets the z values of the point items from the draw order, if it matches their number
+   **/
+  void apply_draw_order();
+  QPainterPath pyramid_path();
+
   QColor m_color;
   int m_pointSize;
   int m_symbol;
   int m_style;
   bool m_continuous;
-  Data m_data;
+  CurveData m_data;
   QTransform m_graphTransform;
   QList<Point*> m_pointItems;
+  QHash<Point*, int> m_point_numbers;
   UpdateFlags m_needsUpdate;
   bool m_autoUpdate;
   QGraphicsPathItem* m_lineItem;
   int m_segmentLength;
   bool m_labels_on_marked;
+  int m_render_mode;
+  ScatterItem* m_scatter_item;
+  QVector<int> m_draw_order;
+  bool m_pyramid_enabled;
+  bool m_update_scheduled;
+  MinMaxPyramid m_pyramid;
 
   QPen m_pen;
   QBrush m_brush;
   QTransform m_zoom_transform;
-  QMap<QByteArray, QFuture<void> > m_property_updates;
-  QFutureWatcher<QPointF> m_pos_watcher;
-  QFutureWatcher<void> m_coords_watcher;
+  QFutureWatcher< QVector<QPointF> > m_pos_watcher;
+  UpdateToken m_pos_token;
+  CurveData m_pos_data;
+  int m_generation;
+  int m_pos_generation;
+  QFutureWatcher< QList<QImage> > m_sprite_watcher;
+  QList<PointData> m_sprite_keys;
   
 };
 
 template <class Sequence, class Updater>
 void Curve::update_items(const Sequence& sequence, Updater updater, Curve::UpdateFlag flag)
 {
-    if (m_currentUpdate.contains(flag) && m_currentUpdate[flag].isRunning())
-    {
-        m_currentUpdate[flag].cancel();
-        m_currentUpdate[flag].waitForFinished();
-    }
-    if (!sequence.isEmpty())
+    Q_UNUSED(flag)
+    // Items may only be changed from the GUI thread, so the updater is applied here, in a single pass
+    typename Sequence::const_iterator it = sequence.constBegin();
+    typename Sequence::const_iterator end = sequence.constEnd();
+    for (; it != end; ++it)
     {
-        m_currentUpdate[flag] = QtConcurrent::map(sequence, updater);
+        updater(*it);
     }
 }
 
 template < class T >
 void Curve::update_point_properties(const QByteArray& property, const QList< T >& values, bool animate)
 {
-    if (m_property_updates.contains(property))
+    // The items have to exist before their properties can be set
+    flush_updates();
+    
+    if (m_render_mode != RenderItems)
     {
-        m_property_updates[property].cancel();
-        m_property_updates[property].waitForFinished();
+        // The batched renderer reads per-point styles from the data, so it only needs a repaint
+        if (m_scatter_item)
+        {
+            m_scatter_item->update_geometry();
+        }
+        return;
     }
     
     update_number_of_items();
@@ -313,21 +498,10 @@ void Curve::update_point_properties(const QByteArray& property, const QList< T >
     }
     else
     {
-        m_property_updates[property] = QtConcurrent::run(this, &Curve::update_point_properties_threaded<T>, property, values);
-    }
-}
-
-template < class T >
-void Curve::update_point_properties_threaded(const QByteArray& property, const QList< T >& values)
-{
-    const int n = values.size();
-    if (n != m_pointItems.size())
-    {
-	return;
-    }
-    for (int i = 0; i < n; ++i)
-    {
-        m_pointItems[i]->setProperty(property, QVariant::fromValue<T>(values[i]));
+        for (int i = 0; i < n; ++i)
+        {
+            m_pointItems[i]->setProperty(property, QVariant::fromValue<T>(values[i]));
+        }
     }
 }
 
@@ -0,0 +1,337 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "curvedata.h"
+
+template <class T, class U>
+static void copy_column(QVector<T>& column, const QList<U>& values)
+{
+    const int n = values.size();
+    column.resize(n);
+    T* d = column.data();
+    for (int i = 0; i < n; ++i)
+    {
+        d[i] = values[i];
+    }
+}
+
+CurveBuffer::~CurveBuffer()
+{
+}
+
+CurveColumn::CurveColumn() : data(0), size(0)
+{
+}
+
+CurveColumn::CurveColumn(const QVector< double >& values) : values(values)
+{
+    data = this->values.constData();
+    size = this->values.size();
+}
+
+CurveColumn::CurveColumn(const double* data, int size, const QSharedPointer< CurveBuffer >& owner) : data(data), size(size), owner(owner)
+{
+}
+
+CurveColumn::CurveColumn(const CurveColumn& other) : data(other.data), size(other.size), owner(other.owner), values(other.values)
+{
+    if (!owner)
+    {
+        data = values.constData();
+    }
+}
+
+CurveColumn& CurveColumn::operator=(const CurveColumn& other)
+{
+    owner = other.owner;
+    values = other.values;
+    size = other.size;
+    data = owner ? other.data : values.constData();
+    return *this;
+}
+
+CurveData::CurveData() : m_size(0)
+{
+}
+
+CurveData::CurveData(const QList< double >& x_data, const QList< double >& y_data) : m_size(0)
+{
+    set_data(x_data, y_data);
+}
+
+int CurveData::size() const
+{
+    return m_size;
+}
+
+bool CurveData::is_empty() const
+{
+    return m_size == 0;
+}
+
+void CurveData::clear()
+{
+    m_x = CurveColumn();
+    m_y = CurveColumn();
+    m_size = 0;
+    clear_styles();
+}
+
+void CurveData::set_data(const QList< double >& x_data, const QList< double >& y_data)
+{
+    Q_ASSERT(x_data.size() == y_data.size());
+    const int n = qMin(x_data.size(), y_data.size());
+    QVector<double> x_values(n);
+    QVector<double> y_values(n);
+    double* x = x_values.data();
+    double* y = y_values.data();
+    for (int i = 0; i < n; ++i)
+    {
+        x[i] = x_data[i];
+        y[i] = y_data[i];
+    }
+    set_data(CurveColumn(x_values), CurveColumn(y_values));
+}
+
+void CurveData::set_data(const CurveColumn& x_data, const CurveColumn& y_data)
+{
+    Q_ASSERT(x_data.size == y_data.size);
+    m_x = x_data;
+    m_y = y_data;
+    m_size = qMin(x_data.size, y_data.size);
+    clear_styles();
+}
+
+void CurveData::append(const QList< double >& x_data, const QList< double >& y_data)
+{
+    Q_ASSERT(x_data.size() == y_data.size());
+    append_values(x_data, y_data, qMin(x_data.size(), y_data.size()));
+}
+
+void CurveData::append(const CurveColumn& x_data, const CurveColumn& y_data)
+{
+    Q_ASSERT(x_data.size == y_data.size);
+    append_values(x_data.data, y_data.data, qMin(x_data.size, y_data.size));
+}
+
+template <class Sequence>
+void CurveData::append_values(const Sequence& x_data, const Sequence& y_data, int n)
+{
+    if (n <= 0)
+    {
+        return;
+    }
+    detach_columns(n);
+    for (int i = 0; i < n; ++i)
+    {
+        m_x.values.append(x_data[i]);
+        m_y.values.append(y_data[i]);
+    }
+    m_x.data = m_x.values.constData();
+    m_y.data = m_y.values.constData();
+    m_size += n;
+    m_x.size = m_size;
+    m_y.size = m_size;
+}
+
+void CurveData::set_point(int i, double x, double y)
+{
+    Q_ASSERT(i >= 0 && i < m_size);
+    detach_columns(0);
+    m_x.values[i] = x;
+    m_y.values[i] = y;
+    m_x.data = m_x.values.constData();
+    m_y.data = m_y.values.constData();
+}
+
+void CurveData::detach_columns(int extra)
+{
+    CurveColumn* columns[] = {&m_x, &m_y};
+    for (int c = 0; c < 2; ++c)
+    {
+        CurveColumn& column = *columns[c];
+        if (column.owner || column.values.size() != m_size)
+        {
+            // Copy the borrowed values, so we can grow them
+            QVector<double> values;
+            values.reserve(m_size + extra);
+            for (int i = 0; i < m_size; ++i)
+            {
+                values.append(column.data[i]);
+            }
+            column.values = values;
+            column.owner.clear();
+        }
+        else if (column.values.capacity() < m_size + extra)
+        {
+            // Grow geometrically, so that appending is amortized over the batch size
+            column.values.reserve(qMax(m_size + extra, 2 * m_size));
+        }
+    }
+}
+
+DataPoint CurveData::data_point(int i) const
+{
+    DataPoint p;
+    p.x = x(i);
+    p.y = y(i);
+    return p;
+}
+
+const double* CurveData::x_data() const
+{
+    return m_x.data;
+}
+
+const double* CurveData::y_data() const
+{
+    return m_y.data;
+}
+
+Data CurveData::to_data() const
+{
+    Data data;
+    const int n = size();
+#if QT_VERSION >= 0x040700
+    data.reserve(n);
+#endif
+    for (int i = 0; i < n; ++i)
+    {
+        data.append(data_point(i));
+    }
+    return data;
+}
+
+QRectF CurveData::bounding_rect(int first) const
+{
+    const int n = size();
+    if (first >= n)
+    {
+        return QRectF();
+    }
+    const double* x = m_x.data;
+    const double* y = m_y.data;
+    double x_min, x_max, y_min, y_max;
+    x_min = x_max = x[first];
+    y_min = y_max = y[first];
+    for (int i = first + 1; i < n; ++i)
+    {
+        x_min = qMin(x_min, x[i]);
+        x_max = qMax(x_max, x[i]);
+        y_min = qMin(y_min, y[i]);
+        y_max = qMax(y_max, y[i]);
+    }
+    return QRectF(x_min, y_min, x_max-x_min, y_max-y_min);
+}
+
+bool CurveData::has_colors() const
+{
+    return !m_colors.isEmpty() && m_colors.size() == size();
+}
+
+QColor CurveData::color(int i, const QColor& fallback) const
+{
+    return has_colors() ? QColor::fromRgba(m_colors.at(i)) : fallback;
+}
+
+const QRgb* CurveData::color_data() const
+{
+    return has_colors() ? m_colors.constData() : 0;
+}
+
+void CurveData::set_colors(const QList< QColor >& colors)
+{
+    const int n = colors.size();
+    m_colors.resize(n);
+    QRgb* d = m_colors.data();
+    for (int i = 0; i < n; ++i)
+    {
+        d[i] = colors[i].rgba();
+    }
+}
+
+void CurveData::set_alpha(int alpha)
+{
+    const int n = m_colors.size();
+    QRgb* d = m_colors.data();
+    for (int i = 0; i < n; ++i)
+    {
+        d[i] = qRgba(qRed(d[i]), qGreen(d[i]), qBlue(d[i]), alpha);
+    }
+}
+
+bool CurveData::has_sizes() const
+{
+    return !m_sizes.isEmpty() && m_sizes.size() == size();
+}
+
+int CurveData::size_at(int i, int fallback) const
+{
+    return has_sizes() ? m_sizes.at(i) : fallback;
+}
+
+void CurveData::set_sizes(const QList< int >& sizes)
+{
+    copy_column(m_sizes, sizes);
+}
+
+bool CurveData::has_symbols() const
+{
+    return !m_symbols.isEmpty() && m_symbols.size() == size();
+}
+
+int CurveData::symbol(int i, int fallback) const
+{
+    return has_symbols() ? m_symbols.at(i) : fallback;
+}
+
+void CurveData::set_symbols(const QList< int >& symbols)
+{
+    copy_column(m_symbols, symbols);
+}
+
+void CurveData::clear_styles()
+{
+    m_colors.clear();
+    m_sizes.clear();
+    m_symbols.clear();
+}
+
+template <class T>
+void CurveData::fill_column(QVector<T>& column, const T& value)
+{
+    // Columns that are not set stay empty, so the curve-wide value still applies to every point
+    const int n = column.size();
+    if (n == 0 || n >= m_size)
+    {
+        return;
+    }
+    column.resize(m_size);
+    T* d = column.data();
+    for (int i = n; i < m_size; ++i)
+    {
+        d[i] = value;
+    }
+}
+
+void CurveData::fill_styles(const QColor& color, int size, int symbol)
+{
+    fill_column(m_colors, color.rgba());
+    fill_column(m_sizes, size);
+    fill_column(m_symbols, symbol);
+}
@@ -0,0 +1,178 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CURVEDATA_H
+#define CURVEDATA_H
+
+#include "point.h"
+
+#include <QtCore/QList>
+#include <QtCore/QVector>
+#include <QtCore/QRectF>
+#include <QtCore/QSharedPointer>
+#include <QtGui/QColor>
+
+typedef QList< DataPoint > Data;
+
+/**
+ * @brief Owner of memory that a CurveColumn borrows
+ *
+ * Subclasses release the memory (for example, a Python buffer) in their destructor.
+ * The last CurveColumn referring to the memory deletes the owner.
+ **/
+class CurveBuffer
+{
+public:
+    virtual ~CurveBuffer();
+};
+
+/**
+ * @brief A single column of coordinates
+ *
+ * The values are either held by the column itself, or borrowed from memory that is
+ * kept alive by @c owner. In both cases @c data points to the first value.
+ **/
+struct CurveColumn
+{
+    CurveColumn();
+    explicit CurveColumn(const QVector<double>& values);
+    CurveColumn(const double* data, int size, const QSharedPointer<CurveBuffer>& owner);
+    CurveColumn(const CurveColumn& other);
+    CurveColumn& operator=(const CurveColumn& other);
+
+    const double* data;
+    int size;
+    QSharedPointer<CurveBuffer> owner;
+    QVector<double> values;
+};
+
+/**
+ * @brief Columnar storage of a curve's data points
+ *
+ * The coordinates are kept in two contiguous arrays of doubles, one for x and one for y.
+ * Per-point style columns (color, size and symbol) are optional: a column is empty
+ * until it is set, in which case the curve-wide value applies to every point.
+ *
+ * The arrays are implicitly shared, so copying a CurveData (for example, to hand it
+ * to a worker thread) does not copy the points. The coordinates may also be borrowed
+ * from an external buffer, such as a numpy array, in which case they are never copied.
+ **/
+class CurveData
+{
+public:
+    CurveData();
+    CurveData(const QList< double >& x_data, const QList< double >& y_data);
+
+    int size() const;
+    bool is_empty() const;
+    void clear();
+
+    void set_data(const QList< double >& x_data, const QList< double >& y_data);
+
+    /**
+     * Sets the coordinates without copying them, if the columns borrow their values
+     **/
+    void set_data(const CurveColumn& x_data, const CurveColumn& y_data);
+
+    /**
+     * Adds points to the end of the data. Borrowed coordinates are copied the first time
+     * this is called, after that the arrays grow in place.
+     * The style columns are not extended, see fill_styles().
+     **/
+    void append(const QList< double >& x_data, const QList< double >& y_data);
+    void append(const CurveColumn& x_data, const CurveColumn& y_data);
+
+    /**
+     * Overwrites the coordinates of an existing point
+     **/
+    void set_point(int i, double x, double y);
+
+    inline double x(int i) const
+    {
+        Q_ASSERT(i >= 0 && i < m_size);
+        return m_x.data[i];
+    }
+
+    inline double y(int i) const
+    {
+        Q_ASSERT(i >= 0 && i < m_size);
+        return m_y.data[i];
+    }
+
+    inline QPointF point(int i) const
+    {
+        return QPointF(x(i), y(i));
+    }
+
+    DataPoint data_point(int i) const;
+
+    const double* x_data() const;
+    const double* y_data() const;
+
+    /**
+     * @return the points as a list of DataPoint, in the format used by the rest of the API
+     **/
+    Data to_data() const;
+    /**
+     * @return the bounding rectangle of the points starting at index @p first
+     **/
+    QRectF bounding_rect(int first = 0) const;
+
+    bool has_colors() const;
+    QColor color(int i, const QColor& fallback = QColor()) const;
+    /**
+     * @return the per-point colors, or 0 if the points do not have their own colors
+     **/
+    const QRgb* color_data() const;
+    void set_colors(const QList< QColor >& colors);
+    void set_alpha(int alpha);
+
+    bool has_sizes() const;
+    int size_at(int i, int fallback = 0) const;
+    void set_sizes(const QList< int >& sizes);
+
+    bool has_symbols() const;
+    int symbol(int i, int fallback = 0) const;
+    void set_symbols(const QList< int >& symbols);
+
+    void clear_styles();
+
+    /**
+     * Extends the per-point style columns that are set to the current number of points, 
+     * giving the new points @p color, @p size and @p symbol. Called after appending points, 
+     * so that the points keep their own styles. 
+     **/
+    void fill_styles(const QColor& color, int size, int symbol);
+
+private:
+    template <class Sequence>
+    void append_values(const Sequence& x_data, const Sequence& y_data, int n);
+    void detach_columns(int extra);
+    template <class T>
+    void fill_column(QVector<T>& column, const T& value);
+
+    int m_size;
+    CurveColumn m_x;
+    CurveColumn m_y;
+
+    QVector<QRgb> m_colors;
+    QVector<int> m_sizes;
+    QVector<int> m_symbols;
+};
+
+#endif // CURVEDATA_H
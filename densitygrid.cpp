@@ -0,0 +1,270 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "densitygrid.h"
+
+#include <QtCore/qmath.h>
+#include <QtCore/QHash>
+
+// Number of points whose pixels are computed before they are counted
+const int BlockSize = 1024;
+
+// Up to this many distinct colors are counted separately, more are treated as a continuous palette
+const int MaxCategories = 16;
+
+DensityGrid::DensityGrid() : m_max_count(0)
+{
+}
+
+void DensityGrid::bin(const CurveData& data, const QColor& color, const QTransform& transform, const QSize& size)
+{
+    m_transform = transform;
+    m_size = size;
+    m_color = color;
+    m_max_count = 0;
+
+    const int w = size.width();
+    const int h = size.height();
+    const int cells = qMax(0, w) * qMax(0, h);
+    m_counts.fill(0, cells);
+
+    const int n = data.size();
+    const QRgb* colors = data.color_data();
+    m_category_colors.clear();
+    m_category_counts.clear();
+    m_red.clear();
+    m_green.clear();
+    m_blue.clear();
+
+    // Each point gets the index of its color, as long as there are only a few distinct colors
+    QVector<quint8> categories;
+    if (colors && cells > 0)
+    {
+        categories.resize(n);
+        QHash<QRgb, int> ids;
+        QRgb last_color = 0;
+        int last_id = -1;
+        for (int i = 0; i < n; ++i)
+        {
+            // Points are often sorted by class, so most lookups are skipped
+            const QRgb c = colors[i] | 0xff000000;
+            if (c != last_color || last_id < 0)
+            {
+                last_color = c;
+                last_id = ids.value(c, -1);
+                if (last_id < 0)
+                {
+                    if (ids.size() == MaxCategories)
+                    {
+                        categories.clear();
+                        m_category_colors.clear();
+                        break;
+                    }
+                    last_id = ids.size();
+                    ids.insert(c, last_id);
+                    m_category_colors << c;
+                }
+            }
+            categories[i] = last_id;
+        }
+    }
+    const int k_categories = m_category_colors.size();
+    const quint8* category = categories.isEmpty() ? 0 : categories.constData();
+    if (category)
+    {
+        m_category_counts.fill(0, cells * k_categories);
+    }
+    else if (colors)
+    {
+        m_red.fill(0, cells);
+        m_green.fill(0, cells);
+        m_blue.fill(0, cells);
+    }
+
+    if (cells == 0 || n == 0)
+    {
+        return;
+    }
+
+    const double* x = data.x_data();
+    const double* y = data.y_data();
+    const bool affine = transform.isAffine();
+    const double m11 = transform.m11(), m12 = transform.m12();
+    const double m21 = transform.m21(), m22 = transform.m22();
+    const double dx = transform.dx(), dy = transform.dy();
+
+    // The pixels are computed in blocks without any branches between points, so the compiler can vectorize
+    // the mapping, and only the counting has to go through the points one by one
+    int index[BlockSize];
+    double px[BlockSize];
+    double py[BlockSize];
+    int* counts = m_counts.data();
+    for (int first = 0; first < n; first += BlockSize)
+    {
+        const int k = qMin(BlockSize, n - first);
+        if (affine)
+        {
+            for (int j = 0; j < k; ++j)
+            {
+                px[j] = m11 * x[first + j] + m21 * y[first + j] + dx;
+                py[j] = m12 * x[first + j] + m22 * y[first + j] + dy;
+            }
+        }
+        else
+        {
+            for (int j = 0; j < k; ++j)
+            {
+                const QPointF p = transform.map(QPointF(x[first + j], y[first + j]));
+                px[j] = p.x();
+                py[j] = p.y();
+            }
+        }
+        for (int j = 0; j < k; ++j)
+        {
+            const bool inside = px[j] >= 0 && px[j] < w && py[j] >= 0 && py[j] < h;
+            index[j] = inside ? int(py[j]) * w + int(px[j]) : -1;
+        }
+
+        for (int j = 0; j < k; ++j)
+        {
+            const int cell = index[j];
+            if (cell < 0)
+            {
+                continue;
+            }
+            m_max_count = qMax(m_max_count, ++counts[cell]);
+            if (category)
+            {
+                // The per-category counts saturate, the total count is still exact
+                quint16& c = m_category_counts[cell * k_categories + category[first + j]];
+                if (c < 0xffff)
+                {
+                    ++c;
+                }
+            }
+            else if (colors)
+            {
+                const QRgb c = colors[first + j];
+                m_red[cell] += qRed(c);
+                m_green[cell] += qGreen(c);
+                m_blue[cell] += qBlue(c);
+            }
+        }
+    }
+}
+
+void DensityGrid::clear()
+{
+    m_transform = QTransform();
+    m_size = QSize();
+    m_counts.clear();
+    m_category_colors.clear();
+    m_category_counts.clear();
+    m_red.clear();
+    m_green.clear();
+    m_blue.clear();
+    m_max_count = 0;
+}
+
+bool DensityGrid::is_empty() const
+{
+    return m_counts.isEmpty();
+}
+
+const QTransform& DensityGrid::transform() const
+{
+    return m_transform;
+}
+
+const QSize& DensityGrid::size() const
+{
+    return m_size;
+}
+
+int DensityGrid::count_at(int x, int y) const
+{
+    if (x < 0 || y < 0 || x >= m_size.width() || y >= m_size.height())
+    {
+        return 0;
+    }
+    return m_counts[y * m_size.width() + x];
+}
+
+int DensityGrid::max_count() const
+{
+    return m_max_count;
+}
+
+QImage DensityGrid::to_image() const
+{
+    if (m_counts.isEmpty())
+    {
+        return QImage();
+    }
+    QImage image(m_size, QImage::Format_ARGB32);
+    image.fill(0);
+
+    const int w = m_size.width();
+    const int h = m_size.height();
+    const bool colored = !m_red.isEmpty();
+    const int k_categories = m_category_colors.size();
+    const quint16* category_counts = m_category_counts.constData();
+    const QRgb base = m_color.rgb();
+    // A logarithmic scale, so that sparse regions are still visible next to dense ones
+    const double scale = m_max_count > 0 ? 255.0 / qLn(1.0 + m_max_count) : 0;
+    const int* counts = m_counts.constData();
+
+    for (int row = 0; row < h; ++row)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(row));
+        for (int column = 0; column < w; ++column)
+        {
+            const int cell = row * w + column;
+            const int c = counts[cell];
+            if (c == 0)
+            {
+                continue;
+            }
+            const int alpha = qBound(1, int(scale * qLn(1.0 + c)), 255);
+            if (k_categories > 0)
+            {
+                // The pixel shows the category with the most points, so it always has the color of a class
+                const quint16* cc = category_counts + cell * k_categories;
+                int best = 0;
+                for (int i = 1; i < k_categories; ++i)
+                {
+                    if (cc[i] > cc[best])
+                    {
+                        best = i;
+                    }
+                }
+                const QRgb b = m_category_colors[best];
+                line[column] = qRgba(qRed(b), qGreen(b), qBlue(b), alpha);
+            }
+            else if (colored)
+            {
+                line[column] = qRgba(int(m_red[cell] / c), int(m_green[cell] / c), int(m_blue[cell] / c), alpha);
+            }
+            else
+            {
+                line[column] = qRgba(qRed(base), qGreen(base), qBlue(base), alpha);
+            }
+        }
+    }
+    return image;
+}
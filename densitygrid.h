@@ -0,0 +1,77 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DENSITYGRID_H
+#define DENSITYGRID_H
+
+#include "curvedata.h"
+
+#include <QtCore/QVector>
+#include <QtGui/QImage>
+#include <QtGui/QTransform>
+
+/**
+ * @brief Counts the points of a curve that fall into each pixel
+ *
+ * With millions of points, individual markers are not visible anyway, so a curve in the
+ * Curve::RenderDensity mode draws a color-mapped image of the counts instead.
+ * Only binning the points depends on their number, drawing depends only on the size of the grid.
+ *
+ * If the points have their own colors, each distinct color is a category, such as a class colored
+ * by a MultiCurve. The points of each category are counted separately, and every pixel gets the color
+ * of the category with the most points in it. Colors from a continuous palette have too many distinct
+ * values to be counted separately, so they are averaged in each pixel instead.
+ **/
+class DensityGrid
+{
+public:
+    DensityGrid();
+
+    /**
+     * Bins the points of @p data, mapped with @p transform, into a grid of @p size pixels.
+     * Points without their own color count as @p color.
+     **/
+    void bin(const CurveData& data, const QColor& color, const QTransform& transform, const QSize& size);
+    void clear();
+
+    bool is_empty() const;
+    const QTransform& transform() const;
+    const QSize& size() const;
+
+    int count_at(int x, int y) const;
+    int max_count() const;
+
+    /**
+     * @return the grid as an image, with the opacity of each pixel proportional to the logarithm of its count
+     **/
+    QImage to_image() const;
+
+private:
+    QTransform m_transform;
+    QSize m_size;
+    QColor m_color;
+    QVector<int> m_counts;
+    QVector<QRgb> m_category_colors;
+    QVector<quint16> m_category_counts;
+    QVector<float> m_red;
+    QVector<float> m_green;
+    QVector<float> m_blue;
+    int m_max_count;
+};
+
+#endif // DENSITYGRID_H
@@ -0,0 +1,186 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "minmaxpyramid.h"
+
+MinMaxPyramid::MinMaxPyramid() : m_built(false), m_valid(false)
+{
+}
+
+void MinMaxPyramid::clear()
+{
+    m_levels.clear();
+    m_built = false;
+    m_valid = false;
+}
+
+void MinMaxPyramid::build(const CurveData& data)
+{
+    clear();
+    m_built = true;
+    m_valid = true;
+    extend(data, 0);
+}
+
+void MinMaxPyramid::extend(const CurveData& data, int previous_size)
+{
+    if (!m_valid)
+    {
+        return;
+    }
+    const int n = data.size();
+    for (int i = qMax(1, previous_size); i < n; ++i)
+    {
+        if (data.x(i) < data.x(i-1))
+        {
+            m_levels.clear();
+            m_valid = false;
+            return;
+        }
+    }
+    update_levels(data, previous_size);
+}
+
+void MinMaxPyramid::update_levels(const CurveData& data, int first)
+{
+    int first_bucket = first;
+    int previous_count = data.size();
+    int level = 1;
+    while (previous_count > 1)
+    {
+        // The last bucket at each level may have been incomplete, so it is recomputed as well
+        first_bucket /= 2;
+        const int count = (previous_count + 1) / 2;
+        if (m_levels.size() < level)
+        {
+            m_levels.resize(level);
+        }
+        QVector<Bucket>& buckets = m_levels[level-1];
+        buckets.resize(count);
+        for (int b = first_bucket; b < count; ++b)
+        {
+            const bool second = (2*b + 1 < previous_count);
+            Bucket& bucket = buckets[b];
+            int lowest = 2*b + 1;
+            int highest = 2*b + 1;
+            if (level == 1)
+            {
+                bucket.lowest = bucket.highest = 2*b;
+            }
+            else
+            {
+                const QVector<Bucket>& below = m_levels[level-2];
+                bucket = below[2*b];
+                if (second)
+                {
+                    lowest = below[2*b + 1].lowest;
+                    highest = below[2*b + 1].highest;
+                }
+            }
+            if (second)
+            {
+                if (data.y(lowest) < data.y(bucket.lowest))
+                {
+                    bucket.lowest = lowest;
+                }
+                if (data.y(highest) > data.y(bucket.highest))
+                {
+                    bucket.highest = highest;
+                }
+            }
+        }
+        previous_count = count;
+        ++level;
+    }
+    m_levels.resize(level - 1);
+}
+
+bool MinMaxPyramid::is_built() const
+{
+    return m_built;
+}
+
+bool MinMaxPyramid::is_valid() const
+{
+    return m_valid;
+}
+
+int MinMaxPyramid::level_count() const
+{
+    return m_levels.size() + 1;
+}
+
+int MinMaxPyramid::level_for(int samples, double pixels) const
+{
+    if (pixels < 1 || samples <= pixels)
+    {
+        return 0;
+    }
+    int level = 0;
+    while (level + 1 < level_count() && ((qint64)2 << level) <= samples / pixels)
+    {
+        ++level;
+    }
+    return level;
+}
+
+void MinMaxPyramid::add_path(QPainterPath& path, const CurveData& data, const QTransform& transform, int level, int first, int last) const
+{
+    if (first >= last)
+    {
+        return;
+    }
+    for (int b = first >> level; b <= ((last - 1) >> level); ++b)
+    {
+        const int start = qMax(first, b << level);
+        const int end = qMin(last, (b + 1) << level) - 1;
+        int lowest = start;
+        int highest = start;
+        if (level > 0)
+        {
+            // The buckets at the edges are only partly visible, their extremes may lie outside
+            const Bucket& bucket = m_levels[level-1][b];
+            if (bucket.lowest >= start && bucket.lowest <= end)
+            {
+                lowest = bucket.lowest;
+            }
+            if (bucket.highest >= start && bucket.highest <= end)
+            {
+                highest = bucket.highest;
+            }
+        }
+
+        const int kept[4] = {start, qMin(lowest, highest), qMax(lowest, highest), end};
+        for (int k = 0; k < 4; ++k)
+        {
+            if (k > 0 && kept[k] == kept[k-1])
+            {
+                continue;
+            }
+            const QPointF p = transform.map(data.point(kept[k]));
+            if (path.elementCount() == 0)
+            {
+                path.moveTo(p);
+            }
+            else
+            {
+                path.lineTo(p);
+            }
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MINMAXPYRAMID_H
+#define MINMAXPYRAMID_H
+
+#include "curvedata.h"
+
+#include <QtCore/QVector>
+#include <QtGui/QPainterPath>
+#include <QtGui/QTransform>
+
+/**
+ * @brief Precomputed minimum and maximum of a time series at several resolutions
+ *
+ * Level 0 is the data itself. At level @c L, the samples are grouped into buckets of 2^L
+ * consecutive samples, and only the indices of the lowest and the highest sample of each bucket are kept.
+ * Every level is built from the one below, so it is half its size.
+ *
+ * The pyramid can only be used if the x coordinates are sorted, otherwise is_valid() returns false.
+ **/
+class MinMaxPyramid
+{
+public:
+    MinMaxPyramid();
+
+    void clear();
+
+    /**
+     * Builds all the levels for @p data
+     **/
+    void build(const CurveData& data);
+
+    /**
+     * Updates the levels after points from @p previous_size onward were appended to @p data.
+     * Only the buckets containing the new points are recomputed.
+     **/
+    void extend(const CurveData& data, int previous_size);
+
+    bool is_built() const;
+    bool is_valid() const;
+
+    /**
+     * @return the number of levels, including level 0
+     **/
+    int level_count() const;
+
+    /**
+     * @return the coarsest level whose buckets contain at most one pixel's worth of samples,
+     * when @p samples samples are shown on @p pixels pixels
+     **/
+    int level_for(int samples, double pixels) const;
+
+    /**
+     * Adds samples [@p first, @p last) at level @p level to @p path, mapped with @p transform.
+     * Each bucket adds its first, lowest, highest and last sample, in their original order.
+     **/
+    void add_path(QPainterPath& path, const CurveData& data, const QTransform& transform, int level, int first, int last) const;
+
+private:
+    struct Bucket
+    {
+        int lowest;
+        int highest;
+    };
+
+    void update_levels(const CurveData& data, int first);
+
+    bool m_built;
+    bool m_valid;
+    QVector< QVector<Bucket> > m_levels;
+};
+
+#endif // MINMAXPYRAMID_H
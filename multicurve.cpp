@@ -26,6 +26,12 @@ MultiCurve::MultiCurve(const QList< double >& x_data, const QList< double >& y_d
     set_data(x_data, y_data);
 }
 
+MultiCurve::MultiCurve(const CurveColumn& x_data, const CurveColumn& y_data): Curve()
+{
+    set_continuous(false);
+    set_data(x_data, y_data);
+}
+
 MultiCurve::~MultiCurve()
 {
 
@@ -33,6 +39,7 @@ MultiCurve::~MultiCurve()
 
 void MultiCurve::set_point_colors(const QList< QColor >& colors)
 {
+    mutable_curve_data().set_colors(colors);
     update_point_properties("color", colors);
 }
 
@@ -43,31 +50,73 @@ void MultiCurve::set_point_labels(const QStringList& labels)
 
 void MultiCurve::set_point_sizes(const QList<int>& sizes)
 {
+    mutable_curve_data().set_sizes(sizes);
     update_point_properties("size", sizes, false);
 }
 
 void MultiCurve::set_point_symbols(const QList< int >& symbols)
 {
+    mutable_curve_data().set_symbols(symbols);
     update_point_properties("symbol", symbols, false);
 }
 
 void MultiCurve::update_properties()
 {
+    if (render_mode() != RenderItems)
+    {
+        Curve::update_properties();
+        return;
+    }
     update_point_coordinates();
+    set_updated(UpdateAll);
 }
 
 void MultiCurve::shuffle_points()
 {
-    update_items(points(), PointShuffler(), UpdateContinuous);
+    shuffle_points(QTime(0,0,0).msecsTo(QTime::currentTime()));
+}
+
+void MultiCurve::shuffle_points(uint seed)
+{
+    const int n = curve_data().size();
+    QVector<int> order(n);
+    for (int i = 0; i < n; ++i)
+    {
+        order[i] = i;
+    }
+    
+    // Fisher-Yates shuffle, with two calls to qrand() per index because RAND_MAX may be as low as 32767
+    qsrand(seed);
+    for (int i = n - 1; i > 0; --i)
+    {
+        const quint32 r = (quint32(qrand()) << 15) ^ quint32(qrand());
+        qSwap(order[i], order[r % (i + 1)]);
+    }
+    set_draw_order(order);
 }
 
 void MultiCurve::set_alpha_value(int alpha)
 {
+    mutable_curve_data().set_alpha(alpha);
+    if (scatter_item())
+    {
+        scatter_item()->update();
+    }
     update_items(points(), PointAlphaUpdater(alpha), UpdateBrush);
 }
 
 void MultiCurve::set_points_marked(const QList< bool >& marked)
 {
+    ScatterItem* scatter = scatter_item();
+    if (scatter)
+    {
+        const int n = qMin(marked.size(), scatter->size());
+        for (int i = 0; i < n; ++i)
+        {
+            scatter->set_state_flag(i, Point::Marked, marked[i]);
+        }
+        return;
+    }
     update_point_properties("marked", marked, false);
 }
 
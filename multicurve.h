@@ -36,19 +36,11 @@ private:
     int alpha;
 };
 
-struct PointShuffler
-{
-    PointShuffler() {qsrand(QTime(0,0,0).msecsTo(QTime::currentTime())); }
-    void operator()(Point* p)
-    {
-        p->setZValue(1.0 * qrand() / RAND_MAX);
-    }
-};
-
 class MultiCurve : public Curve
 {
 public:
     MultiCurve(const QList< double >& x_data, const QList< double >& y_data);
+    MultiCurve(const CurveColumn& x_data, const CurveColumn& y_data);
     virtual ~MultiCurve();
     
     void set_point_colors(const QList<QColor>& colors);
@@ -58,7 +50,14 @@ public:
     
     void set_points_marked(const QList<bool>& marked);
     
+    /**
+     * @brief Draws the points in a random order
+     * 
+     * The order is a permutation stored in the curve, see Curve::set_draw_order(). 
+     * The same @p seed always gives the same order. 
+     **/
     void shuffle_points();
+    void shuffle_points(uint seed);
     void set_alpha_value(int alpha);
 
     virtual void update_properties();
@@ -568,6 +568,7 @@ void NetworkCurve::update_properties()
 {
     cancel_all_updates();
     update_point_positions();
+    set_updated(Curve::UpdateAll);
 }
 
 QRectF NetworkCurve::data_rect() const
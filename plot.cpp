@@ -21,40 +21,92 @@
 #include "point.h"
 
 #include <QtCore/QDebug>
+#include <QtCore/QtAlgorithms>
 #include <QtCore/qmath.h>
 #include <limits>
 
-inline uint qHash(const DataPoint& pos)
-{
-    return pos.x + pos.y;
-}
-
 inline double distance(const QPointF& one, const QPointF& other)
 {
     // For speed, we use the slightly wrong method, also known as Manhattan distance
     return (one - other).manhattanLength();
 }
 
-template <class Area>
-void set_points_state(Area area, QGraphicsScene* scene, Point::StateFlag flag, Plot::SelectionBehavior behavior)
+/**
+ * Tests the candidates against the polygon with the even-odd rule, one edge at a time, 
+ * so that the inner loop over the points has no branches. 
+ **/
+static QVector<int> points_in_polygon(const QPolygonF& polygon, const QVector<QPointF>& positions, const QVector<int>& candidates)
 {
-    /*
-     * NOTE: I think it's faster to rely on Qt to get all items in the current rect
-     * than to iterate over all points on the graph and check which of them are 
-     * inside the specified rect
-     */
-    foreach (QGraphicsItem* item, scene->items(area, Qt::IntersectsItemBoundingRect))
+    const int m = candidates.size();
+    QVector<double> xs(m);
+    QVector<double> ys(m);
+    for (int j = 0; j < m; ++j)
+    {
+        xs[j] = positions[candidates[j]].x();
+        ys[j] = positions[candidates[j]].y();
+    }
+    const double* x = xs.constData();
+    const double* y = ys.constData();
+    
+    QVector<char> inside(m, 0);
+    char* in = inside.data();
+    const int edges = polygon.size();
+    for (int e = 0; e < edges; ++e)
     {
-        Point* point = dynamic_cast<Point*>(item);
-        if (point)
+        QPointF a = polygon[e];
+        QPointF b = polygon[(e + 1) % edges];
+        if (a.y() > b.y())
         {
-            point->set_state_flag(flag, behavior == Plot::AddSelection || (behavior == Plot::ToggleSelection && !point->state_flag(flag)));
+            // Edges are always tested from their lower end, so an edge gives the same result in both directions
+            qSwap(a, b);
+        }
+        if (a.y() == b.y())
+        {
+            // A horizontal edge is never crossed
+            continue;
+        }
+        const double slope = (b.x() - a.x()) / (b.y() - a.y());
+        for (int j = 0; j < m; ++j)
+        {
+            const bool crosses = (a.y() > y[j]) != (b.y() > y[j]);
+            in[j] ^= crosses & (x[j] < a.x() + (y[j] - a.y()) * slope);
+        }
+    }
+    
+    QVector<int> indices;
+    for (int j = 0; j < m; ++j)
+    {
+        if (in[j])
+        {
+            indices << candidates[j];
         }
     }
+    return indices;
+}
+
+/**
+ * @return the indices of the positions in @p index that lie inside @p rect, after mapping it with @p t
+ **/
+static QVector<int> indices_in_area(const PointIndex& index, const QTransform& t, const QRectF& rect)
+{
+    if (t.type() <= QTransform::TxScale)
+    {
+        return index.indices_in(t.mapRect(rect));
+    }
+    const QPolygonF polygon = t.map(QPolygonF(rect));
+    return points_in_polygon(polygon, index.positions(), index.indices_in(polygon.boundingRect()));
+}
+
+static QVector<int> indices_in_area(const PointIndex& index, const QTransform& t, const QPolygonF& area)
+{
+    // The grid only returns the candidates in the bounding rectangle, so most points are never tested
+    const QPolygonF polygon = t.map(area);
+    return points_in_polygon(polygon, index.positions(), index.indices_in(polygon.boundingRect()));
 }
 
 Plot::Plot(QWidget* parent):
-QGraphicsView(parent)
+QGraphicsView(parent),
+m_lasso_active(false)
 {
     setScene(new QGraphicsScene(this));
     
@@ -115,6 +167,7 @@ void Plot::remove_item(PlotItem* item)
         qWarning() << "Trying to remove an item that doesn't belong to this graph";
     }
     remove_all_points(item);
+    m_state_log.remove(item);
 }
 
 void Plot::set_item_in_background(PlotItem* item, bool bg)
@@ -193,6 +246,11 @@ void Plot::set_graph_rect(const QRectF rect)
     }
 }
 
+QRectF Plot::graph_rect() const
+{
+    return graph_item->rect();
+}
+
 void Plot::set_zoom_transform(const QTransform& zoom)
 {
     graph_item->setTransform(zoom);
@@ -203,8 +261,38 @@ void Plot::set_zoom_transform(const QTransform& zoom)
     }
 }
 
+template <class Area>
+void Plot::set_points_state(const Area& area, Point::StateFlag flag, Plot::SelectionBehavior behavior)
+{
+    // The area is in scene coordinates, while the indices are in the coordinates of each item
+    foreach (PlotItem* item, m_point_hash.keys())
+    {
+        const ItemIndex& index = point_index(item);
+        foreach (int i, indices_in_area(index.index, item->sceneTransform().inverted(), area))
+        {
+            Point* point = index.points[i];
+            point->set_state_flag(flag, behavior == Plot::AddSelection || (behavior == Plot::ToggleSelection && !point->state_flag(flag)));
+        }
+    }
+    
+    // Curves drawn with a ScatterItem have no items for individual points, so their index is over the data
+    foreach (ScatterItem* scatter, scatter_items())
+    {
+        const QVector<int> indices = indices_in_area(scatter->point_index(), scatter->sceneTransform().inverted(), area);
+        if (behavior == Plot::ToggleSelection)
+        {
+            scatter->toggle_state_flag(indices, flag);
+        }
+        else
+        {
+            scatter->set_state_flag(indices, flag, behavior == Plot::AddSelection);
+        }
+    }
+}
+
 void Plot::mark_points(const QRectF& rect, Plot::SelectionBehavior behavior)
 {
+    flush_updates();
     if (behavior == ReplaceSelection)
     {
         bool b = blockSignals(true);
@@ -212,12 +300,13 @@ void Plot::mark_points(const QRectF& rect, Plot::SelectionBehavior behavior)
         behavior = AddSelection;
         blockSignals(b);
     }
-    set_points_state(rect, scene(), Point::Marked, behavior);
-    emit marked_points_changed();
+    set_points_state(rect, Point::Marked, behavior);
+    emit_marked_points_changed();
 }
 
 void Plot::mark_points(const QPolygonF& area, Plot::SelectionBehavior behavior)
 {
+    flush_updates();
     if (behavior == ReplaceSelection)
     {
         bool b = blockSignals(true);
@@ -225,12 +314,13 @@ void Plot::mark_points(const QPolygonF& area, Plot::SelectionBehavior behavior)
         behavior = AddSelection;
         blockSignals(b);
     }
-    set_points_state(area, scene(), Point::Marked, behavior);
-    emit marked_points_changed();
+    set_points_state(area, Point::Marked, behavior);
+    emit_marked_points_changed();
 }
 
 void Plot::select_points(const QRectF& rect, Plot::SelectionBehavior behavior)
 {
+    flush_updates();
     if (behavior == ReplaceSelection)
     {
         bool b = blockSignals(true);
@@ -238,12 +328,13 @@ void Plot::select_points(const QRectF& rect, Plot::SelectionBehavior behavior)
         behavior = AddSelection;
         blockSignals(b);
     }
-    set_points_state(rect, scene(), Point::Selected, behavior);
-    emit selection_changed();
+    set_points_state(rect, Point::Selected, behavior);
+    emit_selection_changed();
 }
 
 void Plot::select_points(const QPolygonF& area, Plot::SelectionBehavior behavior)
 {
+    flush_updates();
     if (behavior == ReplaceSelection)
     {
         bool b = blockSignals(true);
@@ -251,36 +342,283 @@ void Plot::select_points(const QPolygonF& area, Plot::SelectionBehavior behavior
         behavior = AddSelection;
         blockSignals(b);
     }
-    set_points_state(area, scene(), Point::Selected, behavior);
-    emit selection_changed();
+    set_points_state(area, Point::Selected, behavior);
+    emit_selection_changed();
+}
+
+void Plot::begin_lasso(Point::StateFlag flag, Plot::SelectionBehavior behavior)
+{
+    flush_updates();
+    const bool replace = (behavior == ReplaceSelection);
+    if (replace)
+    {
+        bool b = blockSignals(true);
+        if (flag == Point::Selected)
+        {
+            unselect_all_points();
+        }
+        else
+        {
+            unmark_all_points();
+        }
+        behavior = AddSelection;
+        blockSignals(b);
+    }
+    
+    m_lasso.clear();
+    m_lasso_items.clear();
+    m_lasso_flag = flag;
+    m_lasso_behavior = behavior;
+    m_lasso_active = true;
+    
+    foreach (PlotItem* item, m_point_hash.keys())
+    {
+        start_lasso_item(item, 0);
+    }
+    foreach (ScatterItem* scatter, scatter_items())
+    {
+        start_lasso_item(scatter, scatter);
+    }
+    
+    if (replace)
+    {
+        emit_state_changed(flag);
+    }
+}
+
+void Plot::add_lasso_vertex(const QPointF& pos)
+{
+    if (!m_lasso_active)
+    {
+        return;
+    }
+    
+    // Items whose points were replaced since the last vertex lost their entry, so they are tested against the whole lasso
+    bool changed = false;
+    const QList<ScatterItem*> scatters = scatter_items();
+    for (QMap<PlotItem*, LassoItem>::iterator it = m_lasso_items.begin(); it != m_lasso_items.end(); )
+    {
+        ScatterItem* scatter = it.value().scatter;
+        if (scatter && (!scatters.contains(scatter) || scatter->size() != it.value().inside.size()))
+        {
+            it = m_lasso_items.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    foreach (PlotItem* item, m_point_hash.keys())
+    {
+        if (!m_lasso_items.contains(item))
+        {
+            changed |= start_lasso_item(item, 0);
+        }
+    }
+    foreach (ScatterItem* scatter, scatters)
+    {
+        if (!m_lasso_items.contains(scatter))
+        {
+            changed |= start_lasso_item(scatter, scatter);
+        }
+    }
+    
+    m_lasso << pos;
+    const int k = m_lasso.size();
+    if (k >= 3)
+    {
+        // The lasso is always closed back to its first vertex. With the even-odd rule, adding a vertex flips 
+        // exactly the points inside the triangle between the first vertex and the newest edge. 
+        QPolygonF triangle;
+        triangle << m_lasso[0] << m_lasso[k - 2] << m_lasso[k - 1];
+        for (QMap<PlotItem*, LassoItem>::iterator it = m_lasso_items.begin(); it != m_lasso_items.end(); ++it)
+        {
+            LassoItem& lasso = it.value();
+            const QPolygonF area = lasso.transform.map(triangle);
+            const QVector<int> flipped = points_in_polygon(area, lasso.index.positions(), lasso.index.indices_in(area.boundingRect()));
+            lasso.inside.toggle(flipped);
+            changed |= apply_lasso(lasso, flipped);
+        }
+    }
+    
+    if (changed)
+    {
+        emit_state_changed(m_lasso_flag);
+    }
+}
+
+void Plot::end_lasso()
+{
+    // The state is already up to date, so only the session is cleared
+    m_lasso_active = false;
+    m_lasso.clear();
+    m_lasso_items.clear();
+}
+
+bool Plot::is_lasso_active() const
+{
+    return m_lasso_active;
+}
+
+bool Plot::start_lasso_item(PlotItem* item, ScatterItem* scatter)
+{
+    // The index and transformation are copied, so that every triangle of the lasso is tested against the same positions
+    LassoItem& lasso = m_lasso_items[item];
+    lasso.scatter = scatter;
+    lasso.transform = item->sceneTransform().inverted();
+    BitSet current;
+    if (scatter)
+    {
+        lasso.points.clear();
+        lasso.index = scatter->point_index();
+        current = scatter->state_bits(m_lasso_flag);
+    }
+    else
+    {
+        const ItemIndex& index = point_index(item);
+        lasso.points = index.points;
+        lasso.index = index.index;
+        current = BitSet(index.points.size());
+        for (int i = 0; i < index.points.size(); ++i)
+        {
+            current.set(i, index.points[i]->state_flag(m_lasso_flag));
+        }
+    }
+    
+    lasso.inside = BitSet(current.size());
+    QVector<int> inside;
+    if (m_lasso.size() >= 3)
+    {
+        const QPolygonF area = lasso.transform.map(m_lasso);
+        inside = points_in_polygon(area, lasso.index.positions(), lasso.index.indices_in(area.boundingRect()));
+        lasso.inside.set(inside);
+    }
+    
+    // Points that are already inside were toggled when they entered the lasso, unless they are new
+    lasso.initial = current;
+    if (m_lasso_behavior == ToggleSelection)
+    {
+        lasso.initial.toggle(lasso.inside);
+    }
+    return apply_lasso(lasso, inside);
+}
+
+bool Plot::apply_lasso(const LassoItem& lasso, const QVector<int>& indices)
+{
+    // Only the points whose state actually changes are set, so they alone are reported with the notification
+    QVector<int> on;
+    QVector<int> off;
+    foreach (int i, indices)
+    {
+        const bool state = lasso_state(lasso.initial.test(i), lasso.inside.test(i));
+        const bool current = lasso.scatter ? lasso.scatter->state_flag(i, m_lasso_flag) : lasso.points[i]->state_flag(m_lasso_flag);
+        if (state == current)
+        {
+            continue;
+        }
+        if (state)
+        {
+            on << i;
+        }
+        else
+        {
+            off << i;
+        }
+    }
+    if (on.isEmpty() && off.isEmpty())
+    {
+        return false;
+    }
+    if (lasso.scatter)
+    {
+        lasso.scatter->set_state_flag(on, m_lasso_flag, true);
+        lasso.scatter->set_state_flag(off, m_lasso_flag, false);
+    }
+    else
+    {
+        foreach (int i, on)
+        {
+            lasso.points[i]->set_state_flag(m_lasso_flag, true);
+        }
+        foreach (int i, off)
+        {
+            lasso.points[i]->set_state_flag(m_lasso_flag, false);
+        }
+    }
+    return true;
+}
+
+bool Plot::lasso_state(bool initial, bool inside) const
+{
+    switch (m_lasso_behavior)
+    {
+        case RemoveSelection:
+            return initial && !inside;
+        case ToggleSelection:
+            return initial != inside;
+        default:
+            return initial || inside;
+    }
 }
 
 QList< bool > Plot::selected_points(const QList< double > x_data, const QList< double > y_data)
 {
+    flush_updates();
     Q_ASSERT(x_data.size() == y_data.size());
     const int n = qMin(x_data.size(), y_data.size());
     QList<bool> selected;
 #if QT_VERSION >= 0x040700
     selected.reserve(n);
 #endif
+    
+    // One pass collects the coordinates of all selected points, and another looks up every row. 
+    // The points are registered with the coordinates from their curve's data, while their own 
+    // coordinates are only set when the background position update finishes, so the keys are used. 
+    PointSet selected_set;
+    foreach (const PointHash& hash, m_point_hash)
+    {
+        for (PointHash::const_iterator it = hash.constBegin(); it != hash.constEnd(); ++it)
+        {
+            if (it.value()->is_selected())
+            {
+                selected_set.insert(it.key());
+            }
+        }
+    }
+    foreach (ScatterItem* scatter, scatter_items())
+    {
+        const CurveData& data = scatter->curve()->curve_data();
+        foreach (int i, scatter->indices_with(Point::Selected))
+        {
+            if (i < data.size())
+            {
+                selected_set.insert(data.data_point(i));
+            }
+        }
+    }
+    
     DataPoint p;
     for (int i = 0; i < n; ++i)
     {
         p.x = x_data[i];
         p.y = y_data[i];
-        selected << (selected_point_at(p) ? true : false);
+        selected << selected_set.contains(p);
     }
     return selected;
 }
 
 QList< Point* > Plot::selected_points()
 {
+    flush_updates();
     QList<Point*> list;
-    foreach (Point* p, all_points())
+    foreach (const PointHash& hash, m_point_hash)
     {
-        if (p->is_selected())
+        foreach (Point* p, hash)
         {
-            list << p;
+            if (p->is_selected())
+            {
+                list << p;
+            }
         }
     }
     qDebug() << "Found" << list.size() << "selected points";
@@ -289,12 +627,16 @@ QList< Point* > Plot::selected_points()
 
 QList< Point* > Plot::marked_points()
 {
+    flush_updates();
     QList<Point*> list;
-    foreach (Point* point, all_points())
+    foreach (const PointHash& hash, m_point_hash)
     {
-        if (point->is_marked())
+        foreach (Point* point, hash)
         {
-            list.append(point);
+            if (point->is_marked())
+            {
+                list.append(point);
+            }
         }
     }
     return list;
@@ -302,6 +644,7 @@ QList< Point* > Plot::marked_points()
 
 Point* Plot::selected_point_at(const DataPoint& pos)
 {
+    flush_updates();
     foreach (PlotItem* item, plot_items())
     {
         if (m_point_set.contains(item) && m_point_set[item].contains(pos))
@@ -320,6 +663,7 @@ Point* Plot::selected_point_at(const DataPoint& pos)
 
 Point* Plot::point_at(const DataPoint& pos)
 {
+    flush_updates();
     foreach (const PointHash& hash, m_point_hash)
     {
         if (hash.contains(pos))
@@ -332,21 +676,28 @@ Point* Plot::point_at(const DataPoint& pos)
 
 Point* Plot::nearest_point(const QPointF& pos)
 {
-    QPointF zoomedPos = graph_item->transform().inverted().map(pos);
+    flush_updates();
+    const QTransform zoom = graph_item->transform();
+    QPointF zoomedPos = zoom.inverted().map(pos);
     QPair<double, Point*> closest_point;
     closest_point.first = std::numeric_limits<double>::max();
     closest_point.second = 0;
     
-    foreach (const PointHash hash, m_point_hash)
+    // Points further than their size on the screen are never returned, so only that neighborhood is searched
+    const double scale = qMin(qAbs(zoom.m11()), qAbs(zoom.m22()));
+    foreach (PlotItem* item, m_point_hash.keys())
     {
-        foreach (Point* p, hash)
+        const ItemIndex& index = point_index(item);
+        const int i = index.index.nearest(zoomedPos, index.max_size / (scale > 0 ? scale : 1.0));
+        if (i < 0)
         {
-            const double d = distance(p->pos(), zoomedPos);
-            if (d < closest_point.first)
-            {
-                closest_point.first = d;
-                closest_point.second = p;
-            }
+            continue;
+        }
+        const double d = distance(index.index.positions()[i], zoomedPos);
+        if (d < closest_point.first)
+        {
+            closest_point.first = d;
+            closest_point.second = index.points[i];
         }
     }
     
@@ -370,6 +721,8 @@ Point* Plot::nearest_point(const QPointF& pos)
 
 void Plot::add_point(Point* point, PlotItem* parent)
 {
+    m_point_index.remove(parent);
+    m_lasso_items.remove(parent);
     const DataPoint pos = point->coordinates();
     m_point_set[parent].insert(pos);
     m_point_hash[parent].insert(pos, point);
@@ -383,8 +736,26 @@ void Plot::add_points(const QList< Point* >& items, PlotItem* parent)
     }
 }
 
+void Plot::add_points(const QList< Point* >& items, const CurveData& data, PlotItem* parent, int first)
+{
+    Q_ASSERT(items.size() == data.size());
+    m_point_index.remove(parent);
+    m_lasso_items.remove(parent);
+    PointSet& set = m_point_set[parent];
+    PointHash& hash = m_point_hash[parent];
+    const int n = qMin(items.size(), data.size());
+    for (int i = first; i < n; ++i)
+    {
+        const DataPoint pos = data.data_point(i);
+        set.insert(pos);
+        hash.insert(pos, items[i]);
+    }
+}
+
 void Plot::remove_point(Point* point, PlotItem* parent)
 {
+    m_point_index.remove(parent);
+    m_lasso_items.remove(parent);
     const DataPoint pos = point->coordinates();
     if (m_point_set.contains(parent) && m_point_set[parent].contains(pos))
     {
@@ -397,24 +768,71 @@ void Plot::remove_all_points(PlotItem* parent)
 {
     m_point_set.remove(parent);
     m_point_hash.remove(parent);
+    m_point_index.remove(parent);
+    m_lasso_items.remove(parent);
+}
+
+void Plot::invalidate_point_index(PlotItem* parent)
+{
+    m_point_index.remove(parent);
+}
+
+const Plot::ItemIndex& Plot::point_index(PlotItem* item)
+{
+    QMap<PlotItem*, ItemIndex>::iterator it = m_point_index.find(item);
+    if (it != m_point_index.end())
+    {
+        return it.value();
+    }
+    
+    // Points are indexed by their position in the graph, before zooming, so zooming does not invalidate the index
+    ItemIndex& index = m_point_index[item];
+    const PointHash& hash = m_point_hash[item];
+    index.points.reserve(hash.size());
+    QVector<QPointF> positions;
+    positions.reserve(hash.size());
+    index.max_size = 0;
+    foreach (Point* p, hash)
+    {
+        index.points << p;
+        positions << p->pos();
+        index.max_size = qMax(index.max_size, p->size());
+    }
+    index.index.build(positions);
+    return index;
 }
 
 void Plot::unmark_all_points()
 {
-    foreach (Point* point, all_points())
+    // Batched curves clear their bits a word at a time, so only point items are visited one by one
+    foreach (const PointHash& hash, m_point_hash)
     {
-        point->set_marked(false);
+        foreach (Point* point, hash)
+        {
+            point->set_marked(false);
+        }
     }
-    emit marked_points_changed();
+    foreach (ScatterItem* scatter, scatter_items())
+    {
+        scatter->set_all_state_flags(Point::Marked, false);
+    }
+    emit_marked_points_changed();
 }
 
 void Plot::unselect_all_points()
 {
-    foreach (Point* point, all_points())
+    foreach (const PointHash& hash, m_point_hash)
+    {
+        foreach (Point* point, hash)
+        {
+            point->set_selected(false);
+        }
+    }
+    foreach (ScatterItem* scatter, scatter_items())
     {
-        point->set_selected(false);
+        scatter->set_all_state_flags(Point::Selected, false);
     }
-    emit selection_changed();
+    emit_selection_changed();
 }
 
 void Plot::selected_to_marked()
@@ -427,8 +845,12 @@ void Plot::selected_to_marked()
 			point->set_selected(false);
 		}
 	}
-	emit selection_changed();
-    emit marked_points_changed();
+	foreach (ScatterItem* scatter, scatter_items())
+	{
+		scatter->move_state_flag(Point::Selected, Point::Marked);
+	}
+	emit_selection_changed();
+    emit_marked_points_changed();
 }
 
 void Plot::marked_to_selected()
@@ -441,44 +863,79 @@ void Plot::marked_to_selected()
 			point->set_marked(false);
 		}
 	}
-	emit selection_changed();
-    emit marked_points_changed();
+	foreach (ScatterItem* scatter, scatter_items())
+	{
+		scatter->move_state_flag(Point::Marked, Point::Selected);
+	}
+	emit_selection_changed();
+    emit_marked_points_changed();
 }
 
 void Plot::mark_points(const Data& data, Plot::SelectionBehavior behavior)
 {
+    flush_updates();
+    set_points_state(data, Point::Marked, behavior);
+    emit_marked_points_changed();
+}
+
+void Plot::select_points(const Data& data, Plot::SelectionBehavior behavior)
+{
+    flush_updates();
+    set_points_state(data, Point::Selected, behavior);
+    emit_selection_changed();
+}
+
+void Plot::set_points_state(const Data& data, Point::StateFlag flag, Plot::SelectionBehavior behavior)
+{
+    // The query is hashed once, so every point is checked in constant time
+    PointSet query;
+    query.reserve(data.size());
+    foreach (const DataPoint& pos, data)
+    {
+        query.insert(pos);
+    }
+    
+    // Like in selected_points(), the registered coordinates are used, because they are never out of date
     foreach (const PointHash& hash, m_point_hash)
     {
-        foreach (Point* point, hash)
+        for (PointHash::const_iterator it = hash.constBegin(); it != hash.constEnd(); ++it)
         {
-            if (data.contains(point->coordinates()))
+            Point* point = it.value();
+            if (query.contains(it.key()))
             {
-                qDebug() << "Found a point, marking it";
-                point->set_marked(behavior == AddSelection || behavior == ReplaceSelection || (behavior == ToggleSelection && !point->is_marked()));
+                point->set_state_flag(flag, behavior == AddSelection || behavior == ReplaceSelection || (behavior == ToggleSelection && !point->state_flag(flag)));
             }
             else if (behavior == ReplaceSelection)
             {
-                point->set_marked(false);
+                point->set_state_flag(flag, false);
             }
         }
     }
-}
-
-void Plot::select_points(const Data& data, Plot::SelectionBehavior behavior)
-{
-    foreach (const PointHash& hash, m_point_hash)
+    
+    foreach (ScatterItem* scatter, scatter_items())
     {
-        foreach (Point* point, hash)
+        const CurveData& curve_data = scatter->curve()->curve_data();
+        const int n = qMin(curve_data.size(), scatter->size());
+        QVector<int> found;
+        for (int i = 0; i < n; ++i)
         {
-            if (data.contains(point->coordinates()))
-            {
-                point->set_selected(behavior == AddSelection || (behavior == ToggleSelection && !point->is_selected()));
-            }
-            else if (behavior == ReplaceSelection)
+            if (query.contains(curve_data.data_point(i)))
             {
-                point->set_selected(false);
+                found << i;
             }
         }
+        if (behavior == ReplaceSelection)
+        {
+            scatter->set_all_state_flags(flag, false);
+        }
+        if (behavior == ToggleSelection)
+        {
+            scatter->toggle_state_flag(found, flag);
+        }
+        else
+        {
+            scatter->set_state_flag(found, flag, behavior != RemoveSelection);
+        }
     }
 }
 
@@ -498,16 +955,113 @@ void Plot::move_selected_points(const DataPoint& d)
 
 void Plot::emit_marked_points_changed()
 {
-	emit marked_points_changed();
+    publish_changes(Point::Marked);
+    emit marked_points_changed();
 }
 
 void Plot::emit_selection_changed()
 {
-	emit selection_changed();
+    publish_changes(Point::Selected);
+    emit selection_changed();
+}
+
+void Plot::emit_state_changed(Point::StateFlag flag)
+{
+    if (flag == Point::Selected)
+    {
+        emit_selection_changed();
+    }
+    else
+    {
+        emit_marked_points_changed();
+    }
+}
+
+QVector< QPair<int, int> > Plot::selection_changes(Curve* curve) const
+{
+    return m_state_log.value(curve).selected_changes;
+}
+
+QVector< QPair<int, int> > Plot::marked_changes(Curve* curve) const
+{
+    return m_state_log.value(curve).marked_changes;
+}
+
+void Plot::record_state_change(PlotItem* item, Point::StateFlag flag, int first, int end)
+{
+    if (first >= end)
+    {
+        return;
+    }
+    StateLog& log = m_state_log[item];
+    QVector< QPair<int, int> >& pending = (flag == Point::Selected) ? log.selected_pending : log.marked_pending;
+    if (!pending.isEmpty() && pending.last().second == first)
+    {
+        // Consecutive points are usually changed in order, so they extend the last range
+        pending.last().second = end;
+        return;
+    }
+    if (pending.size() >= 1024 && pending.size() == pending.capacity())
+    {
+        // While signals are blocked nothing takes the changes, so they are merged before the vector grows
+        merge_ranges(pending);
+    }
+    pending << qMakePair(first, end);
+}
+
+void Plot::record_state_changes(PlotItem* item, Point::StateFlag flag, const QVector< QPair<int, int> >& ranges)
+{
+    typedef QPair<int, int> Range;
+    foreach (const Range& range, ranges)
+    {
+        record_state_change(item, flag, range.first, range.second);
+    }
+}
+
+void Plot::merge_ranges(QVector< QPair<int, int> >& ranges)
+{
+    if (ranges.size() < 2)
+    {
+        return;
+    }
+    qSort(ranges);
+    int last = 0;
+    for (int i = 1; i < ranges.size(); ++i)
+    {
+        if (ranges[i].first <= ranges[last].second)
+        {
+            ranges[last].second = qMax(ranges[last].second, ranges[i].second);
+        }
+        else
+        {
+            ranges[++last] = ranges[i];
+        }
+    }
+    ranges.resize(last + 1);
+}
+
+void Plot::publish_changes(Point::StateFlag flag)
+{
+    if (signalsBlocked())
+    {
+        // Nobody is notified now, so the changes are reported together with the next notification
+        return;
+    }
+    QMap<PlotItem*, StateLog>::iterator it = m_state_log.begin();
+    for (; it != m_state_log.end(); ++it)
+    {
+        StateLog& log = it.value();
+        QVector< QPair<int, int> >& pending = (flag == Point::Selected) ? log.selected_pending : log.marked_pending;
+        QVector< QPair<int, int> >& changes = (flag == Point::Selected) ? log.selected_changes : log.marked_changes;
+        merge_ranges(pending);
+        changes = pending;
+        pending.clear();
+    }
 }
 
 QList< Point* > Plot::all_points()
 {
+    flush_updates();
     QList<Point*> list;
     foreach (PlotItem* item, plot_items())
     {
@@ -521,4 +1075,30 @@ QList< Point* > Plot::all_points()
     return list;
 }
 
+void Plot::flush_updates()
+{
+    foreach (PlotItem* item, m_items)
+    {
+        Curve* curve = qobject_cast<Curve*>(item);
+        if (curve)
+        {
+            curve->flush_updates();
+        }
+    }
+}
+
+QList< ScatterItem* > Plot::scatter_items()
+{
+    QList<ScatterItem*> list;
+    foreach (PlotItem* item, plot_items())
+    {
+        Curve* curve = qobject_cast<Curve*>(item);
+        if (curve && curve->scatter_item())
+        {
+            list << curve->scatter_item();
+        }
+    }
+    return list;
+}
+
 #include "plot.moc"
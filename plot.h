@@ -24,6 +24,7 @@
 #include <QtCore/QMap>
 
 #include "curve.h"
+#include "pointindex.h"
 
 class Point;
 class PlotItem;
@@ -62,6 +63,7 @@ public:
     QList<PlotItem*> plot_items();
     
     void set_graph_rect(const QRectF rect);
+    QRectF graph_rect() const;
     void set_zoom_transform(const QTransform& zoom);
     
     void set_dirty();
@@ -74,6 +76,23 @@ public:
     void mark_points(const QPolygonF& area, SelectionBehavior behavior = AddSelection);
     void mark_points(const Data& data, SelectionBehavior behavior = AddSelection);
     
+    /**
+     * @brief Starts an interactive lasso that changes @p flag on the points inside it
+     * 
+     * Vertices are then added with add_lasso_vertex() as the mouse moves. The lasso is always treated as 
+     * closed, and the points' state is updated after every vertex, so it can be shown while it is drawn. 
+     * Each vertex only tests the points near the newest edge, instead of the whole polygon, and the notification 
+     * it emits only reports the points whose state changed, so a vertex costs as much as the triangle it sweeps. 
+     **/
+    void begin_lasso(Point::StateFlag flag, SelectionBehavior behavior = AddSelection);
+    
+    /**
+     * Adds a vertex, in scene coordinates, to the current lasso, and emits a notification if any point changed
+     **/
+    void add_lasso_vertex(const QPointF& pos);
+    void end_lasso();
+    bool is_lasso_active() const;
+    
     /**
      * For each point defined with @p x_data and @p y_data, this function checks whether such a point is selected. 
      * This function is precise, so you have to supply it with precisely the same data as the curves that 
@@ -90,9 +109,15 @@ public:
 
     void add_point(Point* point, PlotItem* parent);
     void add_points(const QList<Point*>& items, PlotItem* parent);
+    void add_points(const QList<Point*>& items, const CurveData& data, PlotItem* parent, int first = 0);
     void remove_point(Point* point, PlotItem* parent);
     void remove_all_points(PlotItem* parent);
     
+    /**
+     * Tells the plot that the points of @p parent have moved, so its spatial index has to be rebuilt
+     **/
+    void invalidate_point_index(PlotItem* parent);
+    
     void unselect_all_points();
     void unmark_all_points();
     void selected_to_marked();
@@ -102,8 +127,31 @@ public:
 
     bool animate_points;
     
+    /**
+     * Hands out the points that changed since the previous notification, and emits the signal
+     **/
     void emit_marked_points_changed();
     void emit_selection_changed();
+    
+    /**
+     * @brief The points of @p curve whose state changed before the last notification
+     * 
+     * Each range is a pair of the first changed index and one past the last one. 
+     * The ranges are replaced every time selection_changed() or marked_points_changed() is emitted, 
+     * so handlers can update only the points that changed instead of reading the whole selection. 
+     * A point that was changed and then changed back is still included. 
+     **/
+    QVector< QPair<int, int> > selection_changes(Curve* curve) const;
+    QVector< QPair<int, int> > marked_changes(Curve* curve) const;
+    
+    /**
+     * @brief Records that @p flag changed on the points of @p item from @p first up to, but not including, @p end
+     * 
+     * Points and scatter items call this whenever they change a point's state, 
+     * so a notification never has to compare the state of all points. 
+     **/
+    void record_state_change(PlotItem* item, Point::StateFlag flag, int first, int end);
+    void record_state_changes(PlotItem* item, Point::StateFlag flag, const QVector< QPair<int, int> >& ranges);
 
 signals:
     void selection_changed();
@@ -116,6 +164,87 @@ protected:
     bool is_dirty();
     
 private:    
+    QList<ScatterItem*> scatter_items();
+    
+    /**
+     * Applies the pending changes of all curves, so that their points can be queried
+     **/
+    void flush_updates();
+    
+    /**
+     * @brief The point items of one plot item, with a spatial index over their positions
+     **/
+    struct ItemIndex
+    {
+        QVector<Point*> points;
+        PointIndex index;
+        int max_size;
+    };
+    
+    /**
+     * @return the index of the points of @p item, building it if they changed since the last call
+     **/
+    const ItemIndex& point_index(PlotItem* item);
+    
+    /**
+     * Changes @p flag on the points inside @p area, which is given in scene coordinates
+     **/
+    template <class Area>
+    void set_points_state(const Area& area, Point::StateFlag flag, SelectionBehavior behavior);
+    
+    /**
+     * Changes @p flag on the points whose coordinates are in @p data, with a single pass over all curves
+     **/
+    void set_points_state(const Data& data, Point::StateFlag flag, SelectionBehavior behavior);
+    
+    /**
+     * @brief The changes to an item's points since the last notification, and the ones handed out with it
+     **/
+    struct StateLog
+    {
+        QVector< QPair<int, int> > selected_pending;
+        QVector< QPair<int, int> > marked_pending;
+        QVector< QPair<int, int> > selected_changes;
+        QVector< QPair<int, int> > marked_changes;
+    };
+    
+    /**
+     * Sorts @p ranges and joins the ones that overlap or touch
+     **/
+    static void merge_ranges(QVector< QPair<int, int> >& ranges);
+    
+    void publish_changes(Point::StateFlag flag);
+    void emit_state_changed(Point::StateFlag flag);
+    
+    /**
+     * @brief The points of one item during a lasso, with the state they had before it
+     **/
+    struct LassoItem
+    {
+        ScatterItem* scatter;
+        QVector<Point*> points;
+        PointIndex index;
+        QTransform transform;
+        BitSet initial;
+        BitSet inside;
+    };
+    
+    /**
+     * @return whether a point should have the lasso's flag, given its state before the lasso and whether it is inside
+     **/
+    bool lasso_state(bool initial, bool inside) const;
+    
+    /**
+     * @brief Takes the current points of @p item into the lasso, and tests them against the whole polygon
+     * 
+     * The entry is dropped whenever the item's points are added, removed or replaced, 
+     * so the session never keeps pointers to deleted points. 
+     * @return true if the state of any point was changed
+     **/
+    bool start_lasso_item(PlotItem* item, ScatterItem* scatter);
+    bool apply_lasso(const LassoItem& lasso, const QVector<int>& indices);
+    
+
     QList<PlotItem*> m_items;
     bool m_dirty;
     
@@ -126,6 +255,14 @@ private:
     
     QMap<PlotItem*, PointSet> m_point_set;
     QMap<PlotItem*, PointHash> m_point_hash;
+    QMap<PlotItem*, ItemIndex> m_point_index;
+    QMap<PlotItem*, StateLog> m_state_log;
+    
+    QPolygonF m_lasso;
+    bool m_lasso_active;
+    Point::StateFlag m_lasso_flag;
+    SelectionBehavior m_lasso_behavior;
+    QMap<PlotItem*, LassoItem> m_lasso_items;
 };
 
 #endif // PLOT_H
@@ -18,13 +18,40 @@
 
 #include "point.h"
 #include "curve.h"
+#include "plot.h"
+#include "spriteatlas.h"
 
 #include <QtGui/QPainter>
 #include <QtCore/QDebug>
 #include <QtCore/qmath.h>
+#include <QtCore/QMutex>
+#include <cstring>
 #include <QtGui/QStyleOptionGraphicsItem>
 
-QHash<PointData, QPixmap> Point::pixmap_cache;
+// The default memory budget of the sprite cache, in bytes
+const int DefaultCacheLimit = 32 * 1024 * 1024;
+
+// The budget covers both the cached sprites and the sprite atlas, so the cache gets what the atlas may not use
+QCache<PointData, QPixmap> Point::pixmap_cache(DefaultCacheLimit - SpriteAtlas::maximum_bytes(DefaultCacheLimit));
+static int sprite_cache_limit = DefaultCacheLimit;
+QHash<PointData, Point::SymbolMask> Point::mask_cache;
+QHash<QPair<int, int>, Point::SymbolShape> Point::shape_cache;
+
+// Sprites can be rendered on worker threads, so the shape and mask caches are shared between threads, and are only used with shape_mutex locked
+static QMutex shape_mutex;
+
+static qint64 sprite_cache_hits = 0;
+static qint64 sprite_cache_misses = 0;
+static qint64 sprite_cache_evictions = 0;
+
+static void insert_into_cache(const PointData& key, const QPixmap& pixmap)
+{
+    const int count = Point::pixmap_cache.count();
+    const int cost = pixmap.width() * pixmap.height() * qMax(1, pixmap.depth() / 8);
+    Point::pixmap_cache.insert(key, new QPixmap(pixmap), cost);
+    // Inserting may push out the least recently used sprites, or reject this one if it is too large
+    sprite_cache_evictions += count + 1 - Point::pixmap_cache.count();
+}
 
 uint qHash(const PointData& data)
 {
@@ -43,7 +70,7 @@ uint qHash(const PointData& data)
 
 bool operator==(const PointData& one, const PointData& other)
 {
-    return one.symbol == other.symbol && one.size == other.size && one.state == other.state && one.color == other.color;
+    return one.symbol == other.symbol && one.size == other.size && one.state == other.state && one.color == other.color && one.transparent == other.transparent;
 }
 
 QDebug& operator<<(QDebug& stream, const DataPoint& point)
@@ -56,6 +83,29 @@ bool operator==(const DataPoint& one, const DataPoint& other)
     return one.x == other.x && one.y == other.y;
 }
 
+inline quint64 coordinate_bits(double value)
+{
+    // 0.0 and -0.0 compare equal, so they must hash the same
+    if (value == 0)
+    {
+        value = 0;
+    }
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+uint qHash(const DataPoint& pos)
+{
+    // The exact bit patterns are mixed, so that points on a diagonal or a grid do not collide
+    quint64 h = coordinate_bits(pos.x) * Q_UINT64_C(0x9E3779B97F4A7C15);
+    h ^= coordinate_bits(pos.y) + Q_UINT64_C(0x7F4A7C159E3779B9) + (h << 6) + (h >> 2);
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xFF51AFD7ED558CCD);
+    h ^= h >> 33;
+    return uint(h ^ (h >> 32));
+}
+
 DataPoint::operator QPointF() const
 {
     return QPointF(x, y);
@@ -132,72 +182,9 @@ void Point::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWi
     Q_UNUSED(option)
     Q_UNUSED(widget)
     
-    const PointData key(m_size, m_symbol, m_color, m_state, m_transparent);
     // We make the pixmap slighly larger because the point outline has non-zero width
     const int ps = m_size + 4;
-    if (!pixmap_cache.contains(key))
-    {
-        if (m_display_mode == DisplayPath)
-        {
-            QBrush brush(m_color);
-            QPixmap pixmap(ps, ps);
-            pixmap.fill(Qt::transparent);
-            QPainter p;
-            
-            QPen pen(m_color);
-            pen.setWidth(qMin(2, m_size/6));
-            
-            p.begin(&pixmap);
-            p.setRenderHints(painter->renderHints() | QPainter::Antialiasing);
-            if (m_state & Selected)
-            {
-                brush.setColor(m_color);
-                //pen.setStyle(Qt::NoPen);
-            }
-            else if (m_state & Marked)
-            {
-                /*
-            	QRadialGradient g(0.5*ps, 0.5*ps, 0.5*m_size);
-                g.setColorAt(0, m_color);
-                g.setColorAt(0.5, Qt::transparent);
-                g.setColorAt(1, m_color);
-                brush = QBrush(g);
-                pen.setStyle(Qt::NoPen);
-                */
-            	//QColor c = Qt::darkGray;
-            	//c.setAlpha(150);
-            	QColor c = brush.color();
-				//c.setAlpha(m_color.alpha()/6);
-				brush.setColor(c);
-				pen.setColor(Qt::black);
-				pen.setWidth(qMin(3, m_size/3));
-
-            }
-            else
-            {
-                QColor c = brush.color();
-                c.setAlpha(m_color.alpha()/6);
-                brush.setColor(c);
-            }
-            const QPainterPath path = path_for_symbol(m_symbol, m_size).translated(0.5*ps, 0.5*ps);
-
-            if (!m_transparent)
-            {
-            	p.setBrush(Qt::white);
-            	p.drawPath(path);
-            }
-
-            p.setBrush(brush);
-            p.setPen(pen);
-            p.drawPath(path);
-            pixmap_cache.insert(key, pixmap);
-        } 
-        else if (m_display_mode == DisplayPixmap)
-        {
-            pixmap_cache.insert(key, pixmap_for_symbol(m_symbol, m_color, m_size));
-        }
-    }
-    painter->drawPixmap(QPointF(-0.5*ps, -0.5*ps), pixmap_cache.value(key));
+    painter->drawPixmap(QPointF(-0.5*ps, -0.5*ps), sprite(m_symbol, m_color, m_size, m_state, m_transparent, m_display_mode));
     /*
     if (!m_label.isEmpty())
     {        
@@ -211,6 +198,131 @@ void Point::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWi
     */
 }
 
+QPixmap Point::sprite(int symbol, const QColor& color, int size, Point::State state, bool transparent, Point::DisplayMode mode)
+{
+    const PointData key(size, symbol, color, state, transparent);
+    const QPixmap* cached = pixmap_cache.object(key);
+    if (cached)
+    {
+        ++sprite_cache_hits;
+        return *cached;
+    }
+    ++sprite_cache_misses;
+    
+    if (mode == DisplayPath)
+    {
+        const QPixmap pixmap = QPixmap::fromImage(render_sprite(symbol, color, size, state, transparent));
+        insert_into_cache(key, pixmap);
+        return pixmap;
+    } 
+    
+    const QPixmap pixmap = pixmap_for_symbol(symbol, color, size);
+    insert_into_cache(key, pixmap);
+    return pixmap;
+}
+
+QImage Point::render_sprite(int symbol, const QColor& color, int size, Point::State state, bool transparent)
+{
+    // The shape is rendered once per symbol, size and state, and only tinted here
+    const SymbolMask mask = symbol_mask(symbol, size, state);
+    QColor fill_color = color;
+    QColor outline_color = color;
+    if (!(state & (Selected | Marked)))
+    {
+        fill_color.setAlpha(color.alpha()/6);
+    }
+    else if (!(state & Selected))
+    {
+        outline_color = Qt::black;
+    }
+    
+    QImage image(mask.fill.size(), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter p(&image);
+    if (!transparent)
+    {
+        p.drawImage(0, 0, tinted(mask.fill, Qt::white));
+    }
+    p.drawImage(0, 0, tinted(mask.fill, fill_color));
+    p.drawImage(0, 0, tinted(mask.outline, outline_color));
+    p.end();
+    return image;
+}
+
+QList<QImage> Point::render_sprites(const QList<PointData>& keys)
+{
+    QList<QImage> images;
+    foreach (const PointData& key, keys)
+    {
+        images << render_sprite(key.symbol, key.color, key.size, State(QFlag(key.state)), key.transparent);
+    }
+    return images;
+}
+
+void Point::insert_sprite(const PointData& key, const QImage& image)
+{
+    if (!pixmap_cache.contains(key))
+    {
+        insert_into_cache(key, QPixmap::fromImage(image));
+    }
+}
+
+QImage Point::tinted(const QImage& mask, const QColor& color)
+{
+    QImage image = mask;
+    QPainter p(&image);
+    p.setCompositionMode(QPainter::CompositionMode_SourceIn);
+    p.fillRect(image.rect(), color);
+    p.end();
+    return image;
+}
+
+Point::SymbolMask Point::symbol_mask(int symbol, int size, Point::State state)
+{
+    const PointData key(size, symbol, QColor(), state, false);
+    QMutexLocker locker(&shape_mutex);
+    QHash<PointData, SymbolMask>::const_iterator it = mask_cache.constFind(key);
+    if (it != mask_cache.constEnd())
+    {
+        return it.value();
+    }
+    
+    // We make the masks slighly larger because the point outline has non-zero width
+    const int ps = size + 4;
+    const QPainterPath path = symbol_shape(symbol, size).path.translated(0.5*ps, 0.5*ps);
+    SymbolMask mask;
+    
+    mask.fill = QImage(ps, ps, QImage::Format_ARGB32_Premultiplied);
+    mask.fill.fill(Qt::transparent);
+    QPainter p(&mask.fill);
+    p.setRenderHints(QPainter::Antialiasing);
+    p.setPen(Qt::NoPen);
+    p.setBrush(Qt::white);
+    p.drawPath(path);
+    p.end();
+    
+    QPen pen(Qt::white);
+    if ((state & Marked) && !(state & Selected))
+    {
+        pen.setWidth(qMin(3, size/3));
+    }
+    else
+    {
+        pen.setWidth(qMin(2, size/6));
+    }
+    mask.outline = QImage(ps, ps, QImage::Format_ARGB32_Premultiplied);
+    mask.outline.fill(Qt::transparent);
+    p.begin(&mask.outline);
+    p.setRenderHints(QPainter::Antialiasing);
+    p.setPen(pen);
+    p.setBrush(Qt::NoBrush);
+    p.drawPath(path);
+    p.end();
+    
+    mask_cache.insert(key, mask);
+    return mask;
+}
+
 QRectF Point::boundingRect() const
 {
     return rect_for_size(m_size);
@@ -265,9 +377,58 @@ void Point::set_symbol(int symbol)
 }
 
 QPainterPath Point::path_for_symbol(int symbol, int size)
+{
+    QMutexLocker locker(&shape_mutex);
+    return symbol_shape(symbol, size).path;
+}
+
+QList<QPolygonF> Point::outline_for_symbol(int symbol, int size)
+{
+    QMutexLocker locker(&shape_mutex);
+    return symbol_shape(symbol, size).outline;
+}
+
+const Point::SymbolShape& Point::symbol_shape(int symbol, int size)
+{
+    // Called with shape_mutex locked
+    const QPair<int, int> key(symbol, size);
+    QHash<QPair<int, int>, SymbolShape>::const_iterator it = shape_cache.constFind(key);
+    if (it != shape_cache.constEnd())
+    {
+        return it.value();
+    }
+    
+    // Scaling is exact for lines and Bezier curves, so the unit paths can be reused for any size
+    const QTransform scale = QTransform::fromScale(size, size);
+    SymbolShape shape;
+    shape.path = scale.map(unit_path(symbol));
+    shape.outline = shape.path.toSubpathPolygons();
+    return shape_cache.insert(key, shape).value();
+}
+
+const QPainterPath& Point::unit_path(int symbol)
+{
+    // The paths of all symbols at size 1, built only once
+    static QVector<QPainterPath> unit_paths;
+    static const QPainterPath empty;
+    if (unit_paths.isEmpty())
+    {
+        unit_paths.resize(SymbolCount);
+        for (int i = 0; i < SymbolCount; ++i)
+        {
+            unit_paths[i] = build_path(i, 0.5);
+        }
+    }
+    if (symbol < 0 || symbol >= SymbolCount)
+    {
+        return empty;
+    }
+    return unit_paths.at(symbol);
+}
+
+QPainterPath Point::build_path(int symbol, qreal d)
 {
   QPainterPath path;
-  qreal d = 0.5 * size;
   switch (symbol)
   {
     case NoSymbol:
@@ -400,7 +561,9 @@ QRectF Point::rect_for_size(double size)
 
 void Point::set_state(Point::State state) 
 {
+    const State changed = m_state ^ state;
     m_state = state;
+    record_state_change(changed);
 }
 
 Point::State Point::state() const 
@@ -410,6 +573,7 @@ Point::State Point::state() const
 
 void Point::set_state_flag(Point::StateFlag flag, bool on) 
 {
+    const State old = m_state;
     if (on)
     {
         m_state |= flag;
@@ -418,6 +582,7 @@ void Point::set_state_flag(Point::StateFlag flag, bool on)
     {
         m_state &= ~flag;
     }
+    record_state_change(m_state ^ old);
 
     if ((flag == Selected || flag == Marked) && label && ((Curve *)parentObject())->labels_on_marked())
     {
@@ -439,6 +604,33 @@ bool Point::state_flag(Point::StateFlag flag) const
     return m_state & flag;
 }
 
+void Point::record_state_change(Point::State changed)
+{
+    if (!(changed & (Selected | Marked)))
+    {
+        return;
+    }
+    Curve* curve = qobject_cast<Curve*>(parentObject());
+    Plot* plot = curve ? curve->plot() : 0;
+    if (!plot)
+    {
+        return;
+    }
+    const int i = curve->index_of(this);
+    if (i < 0)
+    {
+        return;
+    }
+    if (changed & Selected)
+    {
+        plot->record_state_change(curve, Selected, i, i + 1);
+    }
+    if (changed & Marked)
+    {
+        plot->record_state_change(curve, Marked, i, i + 1);
+    }
+}
+
 void Point::set_selected(bool selected)
 {
     set_state_flag(Selected, selected);
@@ -481,6 +673,61 @@ void Point::set_coordinates(const DataPoint& data_point)
 void Point::clear_cache()
 {
     pixmap_cache.clear();
+    QMutexLocker locker(&shape_mutex);
+    mask_cache.clear();
+    SpriteAtlas::shared().clear();
+}
+
+int Point::cache_limit()
+{
+    return sprite_cache_limit;
+}
+
+void Point::set_cache_limit(int bytes)
+{
+    sprite_cache_limit = qMax(0, bytes);
+    const int atlas_bytes = SpriteAtlas::maximum_bytes(sprite_cache_limit);
+    SpriteAtlas& atlas = SpriteAtlas::shared();
+    if (atlas.bytes() > atlas_bytes)
+    {
+        atlas.clear();
+    }
+    
+    const int count = pixmap_cache.count();
+    pixmap_cache.setMaxCost(sprite_cache_limit - atlas_bytes);
+    sprite_cache_evictions += count - pixmap_cache.count();
+}
+
+int Point::cache_bytes()
+{
+    return pixmap_cache.totalCost() + SpriteAtlas::shared().bytes();
+}
+
+int Point::cache_size()
+{
+    return pixmap_cache.count();
+}
+
+qint64 Point::cache_hits()
+{
+    return sprite_cache_hits;
+}
+
+qint64 Point::cache_misses()
+{
+    return sprite_cache_misses;
+}
+
+qint64 Point::cache_evictions()
+{
+    return sprite_cache_evictions;
+}
+
+void Point::reset_cache_statistics()
+{
+    sprite_cache_hits = 0;
+    sprite_cache_misses = 0;
+    sprite_cache_evictions = 0;
 }
 
 /*
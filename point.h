@@ -22,6 +22,9 @@
 #include <QtGui/QGraphicsObject>
 #include <QtCore/QDebug>
 #include <QtCore/QPropertyAnimation>
+#include <QtCore/QCache>
+#include <QtGui/QImage>
+#include <QtGui/QPolygonF>
 
 struct DataPoint
 {
@@ -35,6 +38,7 @@ Q_DECLARE_METATYPE(DataPoint)
 
 QDebug& operator<<(QDebug& stream, const DataPoint& point);
 bool operator==(const DataPoint& one, const DataPoint& other);
+uint qHash(const DataPoint& pos);
 
 struct PointData
 {
@@ -46,6 +50,9 @@ struct PointData
     bool transparent;
 };
 
+uint qHash(const PointData& data);
+bool operator==(const PointData& one, const PointData& other);
+
 class LabelItem : public QGraphicsTextItem
 {
 public:
@@ -96,6 +103,7 @@ public:
     Star1 = 12,
     Star2 = 13,
     Hexagon = 14,
+    SymbolCount = Hexagon + 1,
     UserStyle = 1000
   };
   
@@ -166,18 +174,104 @@ public:
     **/
     static QPainterPath path_for_symbol(int symbol, int size);
     
+    /**
+    * @brief The outline of a symbol as flat vertex arrays
+    * 
+    * Curves are already flattened at the given size, so the polygons can be fed directly to a rasterizer. 
+    * Closed symbols have one polygon, while crosses and stars have one per stroke. 
+    **/
+    static QList<QPolygonF> outline_for_symbol(int symbol, int size);
+    
     static QPixmap pixmap_for_symbol(int symbol, QColor color, int size);
     static QRectF rect_for_size(double size);
     
+    /**
+    * Returns the cached pixmap used to draw a point with the given properties, rendering it if needed. 
+    * The pixmap is slightly larger than @p size, and should be drawn centered at the point's position. 
+    **/
+    static QPixmap sprite(int symbol, const QColor& color, int size, State state, bool transparent, DisplayMode mode = DisplayPath);
+    
+    /**
+    * @brief Renders a sprite into an image, without touching the sprite cache
+    * 
+    * Unlike sprite(), this does not use any pixmaps, so it is safe to call from any thread. 
+    **/
+    static QImage render_sprite(int symbol, const QColor& color, int size, State state, bool transparent);
+    static QList<QImage> render_sprites(const QList<PointData>& keys);
+    
+    /**
+    * @brief Adds a sprite rendered by render_sprite() to the cache
+    * 
+    * This converts the image to a pixmap, so it must be called from the GUI thread. 
+    **/
+    static void insert_sprite(const PointData& key, const QImage& image);
+    
     static void clear_cache();
+    
+    /**
+    * @brief The memory budget of the sprite cache, in bytes
+    * 
+    * The budget includes the SpriteAtlas, which may take up to half of it. 
+    * When the cache is full, the least recently used sprites are removed to make room for new ones. 
+    **/
+    static int cache_limit();
+    static void set_cache_limit(int bytes);
+    
+    /**
+    * @return the memory taken by the cached sprites and the sprite atlas, in bytes
+    **/
+    static int cache_bytes();
+    static int cache_size();
+    
+    static qint64 cache_hits();
+    static qint64 cache_misses();
+    static qint64 cache_evictions();
+    static void reset_cache_statistics();
 
-    static QHash<PointData, QPixmap> pixmap_cache;
+    static QCache<PointData, QPixmap> pixmap_cache;
 
     LabelItem* label;
 
 
 
 private:
+    /**
+     * Tells the plot which of the point's flags in @p changed were changed, so it can report them
+     **/
+    void record_state_change(State changed);
+    
+    /**
+     * @brief The coverage of a symbol's fill and outline, in white
+     * 
+     * Masks do not depend on the color, so there is only one per symbol, size and state. 
+     * Sprites of any color are made from them by tinting. 
+     **/
+    struct SymbolMask
+    {
+        QImage fill;
+        QImage outline;
+    };
+    
+    static SymbolMask symbol_mask(int symbol, int size, State state);
+    static QImage tinted(const QImage& mask, const QColor& color);
+    
+    static QHash<PointData, SymbolMask> mask_cache;
+    
+    /**
+     * @brief A symbol's path and outline, scaled to one size
+     **/
+    struct SymbolShape
+    {
+        QPainterPath path;
+        QList<QPolygonF> outline;
+    };
+    
+    static const SymbolShape& symbol_shape(int symbol, int size);
+    static const QPainterPath& unit_path(int symbol);
+    static QPainterPath build_path(int symbol, qreal d);
+    
+    static QHash<QPair<int, int>, SymbolShape> shape_cache;
+    
     static QPainterPath trianglePath(double d, double rot);
     static QPainterPath crossPath(double d, double rot);
     static QPainterPath hexPath(double d, bool star);
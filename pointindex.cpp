@@ -0,0 +1,219 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pointindex.h"
+
+#include <QtCore/qmath.h>
+#include <algorithm>
+#include <limits>
+
+// The largest number of cells along one side of the grid
+const int MaxCells = 4096;
+
+inline bool is_finite(double x, double y)
+{
+    return qAbs(x) <= std::numeric_limits<double>::max() && qAbs(y) <= std::numeric_limits<double>::max();
+}
+
+PointIndex::PointIndex() : m_cell_size(1.0), m_columns(0), m_rows(0)
+{
+}
+
+void PointIndex::build(const QVector<QPointF>& positions)
+{
+    clear();
+    m_positions = positions;
+    const int n = positions.size();
+
+    // Positions that are not finite can never be found, so they are left out
+    double left = 0, top = 0, right = 0, bottom = 0;
+    int valid = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        const double x = positions[i].x();
+        const double y = positions[i].y();
+        if (!is_finite(x, y))
+        {
+            continue;
+        }
+        if (valid == 0)
+        {
+            left = right = x;
+            top = bottom = y;
+        }
+        else
+        {
+            left = qMin(left, x);
+            right = qMax(right, x);
+            top = qMin(top, y);
+            bottom = qMax(bottom, y);
+        }
+        ++valid;
+    }
+    if (valid == 0)
+    {
+        return;
+    }
+
+    m_bounds = QRectF(QPointF(left, top), QPointF(right, bottom));
+    const double area = m_bounds.width() * m_bounds.height();
+    const double extent = qMax(m_bounds.width(), m_bounds.height());
+    m_cell_size = area > 0 ? qSqrt(2.0 * area / valid) : 2.0 * extent / valid;
+    m_cell_size = qMax(m_cell_size, extent / MaxCells);
+    if (!(m_cell_size > 0))
+    {
+        m_cell_size = 1.0;
+    }
+    m_columns = qMin(MaxCells, int(m_bounds.width() / m_cell_size) + 1);
+    m_rows = qMin(MaxCells, int(m_bounds.height() / m_cell_size) + 1);
+
+    // A counting sort of the positions by cell, so every cell is a contiguous range of m_entries
+    QVector<int> cells(n, -1);
+    m_cell_start.fill(0, m_columns * m_rows + 1);
+    for (int i = 0; i < n; ++i)
+    {
+        const QPointF& p = positions[i];
+        if (!is_finite(p.x(), p.y()))
+        {
+            continue;
+        }
+        cells[i] = row_of(p.y()) * m_columns + column_of(p.x());
+        ++m_cell_start[cells[i] + 1];
+    }
+    for (int cell = 0; cell < m_columns * m_rows; ++cell)
+    {
+        m_cell_start[cell + 1] += m_cell_start[cell];
+    }
+    m_entries.resize(valid);
+    QVector<int> next = m_cell_start;
+    for (int i = 0; i < n; ++i)
+    {
+        if (cells[i] >= 0)
+        {
+            m_entries[next[cells[i]]++] = i;
+        }
+    }
+}
+
+void PointIndex::clear()
+{
+    m_positions.clear();
+    m_bounds = QRectF();
+    m_cell_size = 1.0;
+    m_columns = 0;
+    m_rows = 0;
+    m_cell_start.clear();
+    m_entries.clear();
+}
+
+bool PointIndex::is_empty() const
+{
+    return m_entries.isEmpty();
+}
+
+const QVector<QPointF>& PointIndex::positions() const
+{
+    return m_positions;
+}
+
+bool PointIndex::overlaps(const QRectF& rect) const
+{
+    // QRectF::intersects() is false for empty rectangles, but the bounds of points on a line are empty
+    return rect.left() <= m_bounds.right() && rect.right() >= m_bounds.left()
+        && rect.top() <= m_bounds.bottom() && rect.bottom() >= m_bounds.top();
+}
+
+int PointIndex::column_of(double x) const
+{
+    return qBound(0, int((x - m_bounds.left()) / m_cell_size), m_columns - 1);
+}
+
+int PointIndex::row_of(double y) const
+{
+    return qBound(0, int((y - m_bounds.top()) / m_cell_size), m_rows - 1);
+}
+
+int PointIndex::nearest(const QPointF& pos, double max_distance) const
+{
+    if (is_empty())
+    {
+        return -1;
+    }
+    const QRectF area(pos.x() - max_distance, pos.y() - max_distance, 2 * max_distance, 2 * max_distance);
+    if (!overlaps(area))
+    {
+        return -1;
+    }
+
+    int best = -1;
+    double best_distance = max_distance;
+    const int first_column = column_of(area.left());
+    const int last_column = column_of(area.right());
+    const int first_row = row_of(area.top());
+    const int last_row = row_of(area.bottom());
+    for (int row = first_row; row <= last_row; ++row)
+    {
+        for (int column = first_column; column <= last_column; ++column)
+        {
+            const int cell = row * m_columns + column;
+            for (int k = m_cell_start[cell]; k < m_cell_start[cell + 1]; ++k)
+            {
+                const int i = m_entries[k];
+                const double d = (m_positions[i] - pos).manhattanLength();
+                if (d < best_distance || (d == best_distance && best == -1))
+                {
+                    best = i;
+                    best_distance = d;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+QVector<int> PointIndex::indices_in(const QRectF& rect) const
+{
+    QVector<int> indices;
+    const QRectF r = rect.normalized();
+    if (is_empty() || !overlaps(r))
+    {
+        return indices;
+    }
+    const int first_column = column_of(r.left());
+    const int last_column = column_of(r.right());
+    const int first_row = row_of(r.top());
+    const int last_row = row_of(r.bottom());
+    for (int row = first_row; row <= last_row; ++row)
+    {
+        for (int column = first_column; column <= last_column; ++column)
+        {
+            const int cell = row * m_columns + column;
+            for (int k = m_cell_start[cell]; k < m_cell_start[cell + 1]; ++k)
+            {
+                const int i = m_entries[k];
+                const QPointF& p = m_positions[i];
+                if (p.x() >= r.left() && p.x() <= r.right() && p.y() >= r.top() && p.y() <= r.bottom())
+                {
+                    indices << i;
+                }
+            }
+        }
+    }
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
@@ -0,0 +1,71 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POINTINDEX_H
+#define POINTINDEX_H
+
+#include <QtCore/QVector>
+#include <QtCore/QPointF>
+#include <QtCore/QRectF>
+
+/**
+ * @brief A uniform grid over a set of positions, for fast spatial queries
+ *
+ * The positions are sorted into square cells, with about two positions per cell on average,
+ * so finding the positions near a given point or inside a small rectangle only looks at a few cells
+ * instead of at every position.
+ *
+ * The index keeps a copy of the positions, and has to be rebuilt when they change.
+ **/
+class PointIndex
+{
+public:
+    PointIndex();
+
+    void build(const QVector<QPointF>& positions);
+    void clear();
+
+    bool is_empty() const;
+    const QVector<QPointF>& positions() const;
+
+    /**
+     * @return the index of the position nearest to @p pos, measured with the Manhattan distance,
+     * or -1 if there is no position within @p max_distance
+     **/
+    int nearest(const QPointF& pos, double max_distance) const;
+
+    /**
+     * @return the indices of all positions inside @p rect, in increasing order
+     **/
+    QVector<int> indices_in(const QRectF& rect) const;
+
+private:
+    bool overlaps(const QRectF& rect) const;
+    int column_of(double x) const;
+    int row_of(double y) const;
+
+    QVector<QPointF> m_positions;
+    QRectF m_bounds;
+    double m_cell_size;
+    int m_columns;
+    int m_rows;
+    QVector<int> m_cell_start;
+    QVector<int> m_entries;
+};
+
+#endif // POINTINDEX_H
@@ -0,0 +1,311 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ringbuffercurve.h"
+#include "plot.h"
+
+// Number of consecutive slots whose line segments share one path item
+const int ChunkSize = 512;
+
+RingBufferCurve::RingBufferCurve(int capacity, QGraphicsItem* parent): Curve(parent),
+    m_capacity(qMax(1, capacity)),
+    m_head(0)
+{
+    const int chunks = (m_capacity + ChunkSize - 1) / ChunkSize;
+    m_chunk_bounds.resize(chunks);
+}
+
+RingBufferCurve::~RingBufferCurve()
+{
+}
+
+void RingBufferCurve::update_properties()
+{
+    Curve::update_properties();
+    const bool lines = shows_lines();
+    foreach (QGraphicsPathItem* item, m_chunk_items)
+    {
+        item->setVisible(lines);
+    }
+}
+
+int RingBufferCurve::capacity() const
+{
+    return m_capacity;
+}
+
+void RingBufferCurve::add_samples(const QList< double >& x_data, const QList< double >& y_data)
+{
+    Q_ASSERT(x_data.size() == y_data.size());
+    add(x_data, y_data, qMin(x_data.size(), y_data.size()));
+}
+
+void RingBufferCurve::add_samples(const CurveColumn& x_data, const CurveColumn& y_data)
+{
+    Q_ASSERT(x_data.size == y_data.size);
+    add(x_data.data, y_data.data, qMin(x_data.size, y_data.size));
+}
+
+void RingBufferCurve::clear_samples()
+{
+    m_head = 0;
+    m_dirty_bounds.clear();
+    m_dirty_paths.clear();
+    foreach (QGraphicsPathItem* item, m_chunk_items)
+    {
+        item->setPath(QPainterPath());
+    }
+    Curve::set_data(QList<double>(), QList<double>());
+}
+
+void RingBufferCurve::set_data(const QList< double > x_data, const QList< double > y_data)
+{
+    clear_samples();
+    add_samples(x_data, y_data);
+}
+
+void RingBufferCurve::set_data(const CurveColumn& x_data, const CurveColumn& y_data)
+{
+    clear_samples();
+    add_samples(x_data, y_data);
+}
+
+void RingBufferCurve::append_data(const QList< double > x_data, const QList< double > y_data)
+{
+    add_samples(x_data, y_data);
+}
+
+void RingBufferCurve::append_data(const CurveColumn& x_data, const CurveColumn& y_data)
+{
+    add_samples(x_data, y_data);
+}
+
+template <class Sequence>
+void RingBufferCurve::add(const Sequence& x_data, const Sequence& y_data, int n)
+{
+    // Samples that would be overwritten within the same batch are skipped
+    int i = qMax(0, n - m_capacity);
+    const int previous_size = curve_data().size();
+
+    if (previous_size < m_capacity && i < n)
+    {
+        // While the buffer is filling up, the samples are simply appended
+        const int k = qMin(m_capacity - previous_size, n - i);
+        QVector<double> x_values(k);
+        QVector<double> y_values(k);
+        for (int j = 0; j < k; ++j)
+        {
+            x_values[j] = x_data[i + j];
+            y_values[j] = y_data[i + j];
+        }
+        for (int slot = previous_size; slot < previous_size + k; ++slot)
+        {
+            mark_dirty(slot);
+        }
+        Curve::append_data(CurveColumn(x_values), CurveColumn(y_values));
+        i += k;
+    }
+
+    if (i < n)
+    {
+        CurveData& data = mutable_curve_data();
+        const QTransform t = graph_transform();
+
+        // Only move the points if they are up to date, otherwise a full update is needed anyway
+        const QList<Point*> items = points();
+        const bool move_items = shows_points() && render_mode() == RenderItems && auto_update()
+            && items.size() == data.size() && !(needs_update() & (UpdateNumberOfItems | UpdatePosition)) && !is_updating();
+        Plot* p = plot();
+
+        for (; i < n; ++i)
+        {
+            const int slot = m_head;
+            m_head = (m_head + 1) % m_capacity;
+            data.set_point(slot, x_data[i], y_data[i]);
+            mark_dirty(slot);
+
+            if (move_items)
+            {
+                Point* point = items[slot];
+                if (p)
+                {
+                    p->remove_point(point, this);
+                }
+                point->set_coordinates(data.data_point(slot));
+                point->setPos(t.map(data.point(slot)));
+                if (p)
+                {
+                    p->add_point(point, this);
+                }
+            }
+        }
+
+        if (!move_items && shows_points() && render_mode() == RenderItems)
+        {
+            set_dirty(UpdatePosition);
+        }
+        if (shows_lines())
+        {
+            update_line_path(previous_size ? previous_size : 1);
+        }
+    }
+
+    update_data_rect();
+    if (scatter_item())
+    {
+        scatter_item()->update_geometry();
+    }
+}
+
+int RingBufferCurve::newest() const
+{
+    const int count = curve_data().size();
+    if (count < m_capacity)
+    {
+        return count - 1;
+    }
+    return (m_head + m_capacity - 1) % m_capacity;
+}
+
+void RingBufferCurve::mark_dirty(int slot)
+{
+    // The chunk before the slot holds the segment that ends at it
+    const int chunk = slot / ChunkSize;
+    const int previous = ((slot + m_capacity - 1) % m_capacity) / ChunkSize;
+    m_dirty_bounds << chunk;
+    m_dirty_paths << chunk << previous;
+}
+
+QPainterPath RingBufferCurve::chunk_path(int chunk) const
+{
+    const CurveData& data = curve_data();
+    const QTransform t = graph_transform();
+    const int count = data.size();
+    const bool full = (count == m_capacity);
+    const int last_written = newest();
+    const int first = chunk * ChunkSize;
+    const int last = qMin(first + ChunkSize, count);
+
+    // Every slot is connected to the next one, except for the newest sample,
+    // which is not connected to the oldest one
+    QPainterPath path;
+    bool open = false;
+    for (int i = first; i < last; ++i)
+    {
+        int next = i + 1;
+        if (next == count)
+        {
+            next = 0;
+        }
+        if (i == last_written || (next == 0 && !full))
+        {
+            open = false;
+            continue;
+        }
+        if (!open)
+        {
+            path.moveTo(t.map(data.point(i)));
+        }
+        path.lineTo(t.map(data.point(next)));
+        open = true;
+    }
+    return path;
+}
+
+void RingBufferCurve::update_line_path(int first)
+{
+    const int chunks = m_chunk_bounds.size();
+    QPen p = pen();
+    p.setCosmetic(true);
+    p.setStyle((Qt::PenStyle)style());
+
+    if (m_chunk_items.isEmpty())
+    {
+        m_chunk_items.resize(chunks);
+        for (int chunk = 0; chunk < chunks; ++chunk)
+        {
+            m_chunk_items[chunk] = new QGraphicsPathItem(this);
+        }
+        first = 0;
+    }
+
+    if (first == 0)
+    {
+        // The transformation or the pen may have changed, so every chunk is rebuilt
+        for (int chunk = 0; chunk < chunks; ++chunk)
+        {
+            m_chunk_items[chunk]->setPen(p);
+            m_chunk_items[chunk]->setPath(chunk_path(chunk));
+        }
+    }
+    else
+    {
+        foreach (int chunk, m_dirty_paths)
+        {
+            m_chunk_items[chunk]->setPath(chunk_path(chunk));
+        }
+    }
+    m_dirty_paths.clear();
+}
+
+void RingBufferCurve::update_data_rect()
+{
+    const CurveData& data = curve_data();
+    const int count = data.size();
+
+    foreach (int chunk, m_dirty_bounds)
+    {
+        const int first = chunk * ChunkSize;
+        const int last = qMin(first + ChunkSize, count);
+        if (first >= last)
+        {
+            continue;
+        }
+        double x_min, x_max, y_min, y_max;
+        x_min = x_max = data.x(first);
+        y_min = y_max = data.y(first);
+        for (int i = first + 1; i < last; ++i)
+        {
+            x_min = qMin(x_min, data.x(i));
+            x_max = qMax(x_max, data.x(i));
+            y_min = qMin(y_min, data.y(i));
+            y_max = qMax(y_max, data.y(i));
+        }
+        m_chunk_bounds[chunk] = QRectF(x_min, y_min, x_max-x_min, y_max-y_min);
+    }
+    m_dirty_bounds.clear();
+
+    // The data rect is the union of the chunks' bounds, so it also shrinks when old samples are overwritten
+    const int chunks = qMin(m_chunk_bounds.size(), (count + ChunkSize - 1) / ChunkSize);
+    if (chunks == 0)
+    {
+        set_data_rect(QRectF());
+        return;
+    }
+    QRectF r = m_chunk_bounds[0];
+    double left = r.left(), top = r.top(), right = r.right(), bottom = r.bottom();
+    for (int chunk = 1; chunk < chunks; ++chunk)
+    {
+        r = m_chunk_bounds[chunk];
+        left = qMin(left, r.left());
+        top = qMin(top, r.top());
+        right = qMax(right, r.right());
+        bottom = qMax(bottom, r.bottom());
+    }
+    set_data_rect(QRectF(QPointF(left, top), QPointF(right, bottom)));
+}
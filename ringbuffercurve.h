@@ -0,0 +1,85 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RINGBUFFERCURVE_H
+#define RINGBUFFERCURVE_H
+
+#include "curve.h"
+
+#include <QtCore/QSet>
+
+/**
+ * @brief A curve that shows the most recent samples of a stream
+ *
+ * The curve holds at most capacity() points. Once it is full, every new sample overwrites
+ * the oldest one, so the memory use stays constant.
+ *
+ * The line is split into chunks of consecutive slots, each with its own path item,
+ * and only the chunks containing overwritten samples are rebuilt.
+ * Likewise, only the points for the new samples are moved.
+ *
+ * The segment length setting is ignored, because the position of a sample in the stream changes with every update.
+ **/
+class RingBufferCurve : public Curve
+{
+public:
+    explicit RingBufferCurve(int capacity, QGraphicsItem* parent = 0);
+    virtual ~RingBufferCurve();
+
+    virtual void update_properties();
+
+    int capacity() const;
+
+    void add_samples(const QList< double >& x_data, const QList< double >& y_data);
+    void add_samples(const CurveColumn& x_data, const CurveColumn& y_data);
+    void clear_samples();
+
+    /**
+     * Replaces all the samples with the last capacity() points of @p x_data and @p y_data.
+     * These hide the functions of Curve, which do not keep the ring's head and chunks consistent.
+     **/
+    void set_data(const QList<double> x_data, const QList<double> y_data);
+    void set_data(const CurveColumn& x_data, const CurveColumn& y_data);
+    
+    /**
+     * Same as add_samples()
+     **/
+    void append_data(const QList<double> x_data, const QList<double> y_data);
+    void append_data(const CurveColumn& x_data, const CurveColumn& y_data);
+
+protected:
+    virtual void update_line_path(int first);
+
+private:
+    template <class Sequence>
+    void add(const Sequence& x_data, const Sequence& y_data, int n);
+
+    int newest() const;
+    void mark_dirty(int slot);
+    QPainterPath chunk_path(int chunk) const;
+    void update_data_rect();
+
+    int m_capacity;
+    int m_head;
+    QVector<QGraphicsPathItem*> m_chunk_items;
+    QVector<QRectF> m_chunk_bounds;
+    QSet<int> m_dirty_bounds;
+    QSet<int> m_dirty_paths;
+};
+
+#endif // RINGBUFFERCURVE_H
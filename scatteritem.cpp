@@ -0,0 +1,387 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scatteritem.h"
+#include "curve.h"
+#include "plot.h"
+#include "spriteatlas.h"
+#include "tilelayer.h"
+
+#include <QtGui/QPainter>
+#include <QtGui/QPaintDevice>
+
+ScatterItem::ScatterItem(Curve* curve): PlotItem(curve),
+    m_curve(curve),
+    m_tiles(0),
+    m_index_valid(false)
+{
+    // Unlike most plot items, this one does its own painting
+    setFlag(ItemHasNoContents, false);
+}
+
+ScatterItem::~ScatterItem()
+{
+    delete m_tiles;
+}
+
+void ScatterItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+    Q_UNUSED(option)
+    Q_UNUSED(widget)
+
+    const CurveData& data = m_curve->curve_data();
+    const int n = qMin(data.size(), size());
+    if (n == 0)
+    {
+        return;
+    }
+
+    // Points are not affected by zooming, so we draw them in device coordinates
+    const QTransform t = m_curve->graph_transform() * painter->worldTransform();
+    QRectF visible;
+    if (painter->device())
+    {
+        visible = QRectF(0, 0, painter->device()->width(), painter->device()->height());
+    }
+
+    painter->save();
+    painter->resetTransform();
+    if (m_curve->render_mode() == Curve::RenderDensity && visible.isValid())
+    {
+        draw_density(painter, t, visible);
+        painter->restore();
+        return;
+    }
+    if (m_curve->render_mode() == Curve::RenderTiled && visible.isValid())
+    {
+        if (!m_tiles)
+        {
+            m_tiles = new TileLayer(this);
+        }
+        m_tiles->draw(painter, t, visible.size().toSize());
+        painter->restore();
+        return;
+    }
+#if QT_VERSION >= 0x040700
+    if (!draw_fragments(painter, t, visible))
+    {
+        draw_pixmaps(painter, t, visible);
+    }
+#else
+    draw_pixmaps(painter, t, visible);
+#endif
+    painter->restore();
+}
+
+bool ScatterItem::draw_fragments(QPainter* painter, const QTransform& t, const QRectF& visible)
+{
+#if QT_VERSION >= 0x040700
+    const CurveData& data = m_curve->curve_data();
+    const int n = qMin(data.size(), size());
+    const QColor color = m_curve->color();
+    const int size = m_curve->point_size();
+    const int symbol = m_curve->symbol();
+
+    // All the sprites are in one atlas, so the visible points are drawn with a single call
+    SpriteAtlas& atlas = SpriteAtlas::shared();
+    const int generation = atlas.generation();
+    QVector<QPainter::PixmapFragment> fragments;
+    fragments.reserve(n);
+    const int* order = draw_order();
+    for (int k = 0; k < n; ++k)
+    {
+        const int i = order ? order[k] : k;
+        const QPointF pos = t.map(data.point(i));
+        const int s = data.size_at(i, size);
+        const double ps = s + 4;
+        if (visible.isValid() && !visible.intersects(QRectF(pos.x() - 0.5*ps, pos.y() - 0.5*ps, ps, ps)))
+        {
+            continue;
+        }
+        const QRect source = atlas.sprite_rect(data.symbol(i, symbol), data.color(i, color), s, state(i), true);
+        if (atlas.generation() != generation)
+        {
+            // The atlas was refilled, so the rectangles collected so far are no longer valid
+            return false;
+        }
+        fragments << QPainter::PixmapFragment::create(pos, source);
+    }
+    painter->drawPixmapFragments(fragments.constData(), fragments.size(), atlas.pixmap());
+    return true;
+#else
+    Q_UNUSED(painter)
+    Q_UNUSED(t)
+    Q_UNUSED(visible)
+    return false;
+#endif
+}
+
+void ScatterItem::draw_pixmaps(QPainter* painter, const QTransform& t, const QRectF& visible)
+{
+    const CurveData& data = m_curve->curve_data();
+    const int n = qMin(data.size(), size());
+    const QColor color = m_curve->color();
+    const int size = m_curve->point_size();
+    const int symbol = m_curve->symbol();
+
+    const int* order = draw_order();
+    for (int k = 0; k < n; ++k)
+    {
+        const int i = order ? order[k] : k;
+        const QPointF pos = t.map(data.point(i));
+        const int s = data.size_at(i, size);
+        const double ps = s + 4;
+        if (visible.isValid() && !visible.intersects(QRectF(pos.x() - 0.5*ps, pos.y() - 0.5*ps, ps, ps)))
+        {
+            continue;
+        }
+        const QPixmap pixmap = Point::sprite(data.symbol(i, symbol), data.color(i, color), s, state(i), true);
+        painter->drawPixmap(QPointF(pos.x() - 0.5*ps, pos.y() - 0.5*ps), pixmap);
+    }
+}
+
+void ScatterItem::draw_density(QPainter* painter, const QTransform& t, const QRectF& visible)
+{
+    // The points are only binned again when the view or the data change
+    const QSize size = visible.size().toSize();
+    if (m_density_image.isNull() || m_density.transform() != t || m_density.size() != size)
+    {
+        m_density.bin(m_curve->curve_data(), m_curve->color(), t, size);
+        m_density_image = m_density.to_image();
+    }
+    painter->drawImage(QPointF(0, 0), m_density_image);
+}
+
+const int* ScatterItem::draw_order() const
+{
+    const QVector<int>& order = m_curve->draw_order();
+    const int n = m_curve->curve_data().size();
+    return (order.size() == n && size() == n) ? order.constData() : 0;
+}
+
+QRectF ScatterItem::boundingRect() const
+{
+    return m_bounding_rect;
+}
+
+void ScatterItem::update_geometry()
+{
+    const CurveData& data = m_curve->curve_data();
+    m_index_valid = false;
+    m_selected.resize(data.size());
+    m_marked.resize(data.size());
+
+    int max_size = m_curve->point_size();
+    if (data.has_sizes())
+    {
+        for (int i = 0; i < data.size(); ++i)
+        {
+            max_size = qMax(max_size, data.size_at(i));
+        }
+    }
+
+    // The margin is given in pixels, but the bounding rect is affected by the zoom
+    const QTransform zoom = m_curve->zoom_transform();
+    const double scale = qMin(qAbs(zoom.m11()), qAbs(zoom.m22()));
+    const double margin = (max_size + 4) / (scale > 0 ? scale : 1.0);
+
+    prepareGeometryChange();
+    if (data.is_empty())
+    {
+        m_bounding_rect = QRectF();
+    }
+    else
+    {
+        m_bounding_rect = m_curve->graph_transform().mapRect(m_curve->data_rect()).adjusted(-margin, -margin, margin, margin);
+    }
+    changed();
+}
+
+Curve* ScatterItem::curve() const
+{
+    return m_curve;
+}
+
+int ScatterItem::size() const
+{
+    return m_selected.size();
+}
+
+QPointF ScatterItem::scene_position(int index) const
+{
+    return sceneTransform().map(m_curve->graph_transform().map(m_curve->curve_data().point(index)));
+}
+
+Point::State ScatterItem::state(int index) const
+{
+    Point::State state = Point::Normal;
+    if (m_selected.test(index))
+    {
+        state |= Point::Selected;
+    }
+    if (m_marked.test(index))
+    {
+        state |= Point::Marked;
+    }
+    return state;
+}
+
+const BitSet& ScatterItem::state_bits(Point::StateFlag flag) const
+{
+    return (flag == Point::Selected) ? m_selected : m_marked;
+}
+
+BitSet& ScatterItem::mutable_state_bits(Point::StateFlag flag)
+{
+    return (flag == Point::Selected) ? m_selected : m_marked;
+}
+
+void ScatterItem::set_state(int index, Point::State state)
+{
+    const bool selected = state & Point::Selected;
+    const bool marked = state & Point::Marked;
+    if (m_selected.test(index) != selected)
+    {
+        m_selected.set(index, selected);
+        record_change(Point::Selected, index, index + 1);
+    }
+    if (m_marked.test(index) != marked)
+    {
+        m_marked.set(index, marked);
+        record_change(Point::Marked, index, index + 1);
+    }
+    changed();
+}
+
+bool ScatterItem::state_flag(int index, Point::StateFlag flag) const
+{
+    return state_bits(flag).test(index);
+}
+
+void ScatterItem::set_state_flag(int index, Point::StateFlag flag, bool on)
+{
+    BitSet& bits = mutable_state_bits(flag);
+    if (bits.test(index) != on)
+    {
+        bits.set(index, on);
+        record_change(flag, index, index + 1);
+    }
+    changed();
+}
+
+void ScatterItem::set_all_state_flags(Point::StateFlag flag, bool on)
+{
+    const BitSet before = state_bits(flag);
+    mutable_state_bits(flag).fill(on);
+    record_changes(flag, before);
+    changed();
+}
+
+void ScatterItem::set_state_flag(const QVector<int>& indices, Point::StateFlag flag, bool on)
+{
+    BitSet& bits = mutable_state_bits(flag);
+    foreach (int i, indices)
+    {
+        if (bits.test(i) != on)
+        {
+            record_change(flag, i, i + 1);
+        }
+    }
+    bits.set(indices, on);
+    changed();
+}
+
+void ScatterItem::toggle_state_flag(const QVector<int>& indices, Point::StateFlag flag)
+{
+    mutable_state_bits(flag).toggle(indices);
+    foreach (int i, indices)
+    {
+        record_change(flag, i, i + 1);
+    }
+    changed();
+}
+
+QVector<int> ScatterItem::indices_with(Point::StateFlag flag) const
+{
+    return state_bits(flag).indices();
+}
+
+const PointIndex& ScatterItem::point_index()
+{
+    if (!m_index_valid)
+    {
+        const CurveData& data = m_curve->curve_data();
+        const QTransform t = m_curve->graph_transform();
+        const int n = qMin(data.size(), size());
+        QVector<QPointF> positions(n);
+        for (int i = 0; i < n; ++i)
+        {
+            positions[i] = t.map(data.point(i));
+        }
+        m_index.build(positions);
+        m_index_valid = true;
+    }
+    return m_index;
+}
+
+void ScatterItem::move_state_flag(Point::StateFlag from_flag, Point::StateFlag to_flag)
+{
+    if (from_flag != to_flag)
+    {
+        // Whole words are copied, so this takes the same time regardless of how many points have the flag
+        const BitSet to_before = state_bits(to_flag);
+        const BitSet from_before = state_bits(from_flag);
+        mutable_state_bits(to_flag) = from_before;
+        mutable_state_bits(from_flag).fill(false);
+        record_changes(to_flag, to_before);
+        record_changes(from_flag, from_before);
+    }
+    changed();
+}
+
+void ScatterItem::record_change(Point::StateFlag flag, int first, int end)
+{
+    Plot* plot = m_curve->plot();
+    if (plot)
+    {
+        plot->record_state_change(m_curve, flag, first, end);
+    }
+}
+
+void ScatterItem::record_changes(Point::StateFlag flag, const BitSet& before)
+{
+    Plot* plot = m_curve->plot();
+    if (plot)
+    {
+        // The sets are compared a word at a time, like the operations that changed them
+        BitSet difference = state_bits(flag);
+        difference.toggle(before);
+        plot->record_state_changes(m_curve, flag, difference.ranges());
+    }
+}
+
+void ScatterItem::changed()
+{
+    if (m_tiles)
+    {
+        m_tiles->invalidate();
+    }
+    m_density.clear();
+    m_density_image = QImage();
+    update();
+}
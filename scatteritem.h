@@ -0,0 +1,136 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCATTERITEM_H
+#define SCATTERITEM_H
+
+#include "plotitem.h"
+#include "point.h"
+#include "densitygrid.h"
+#include "pointindex.h"
+#include "bitset.h"
+
+#include <QtCore/QVector>
+
+class Curve;
+class TileLayer;
+
+/**
+ * @brief Draws all the points of a curve in a single item
+ *
+ * Instead of creating a Point for every data point, a curve in the Curve::RenderBatched mode
+ * creates one ScatterItem. It reads the positions and per-point styles from the curve's data,
+ * and draws every point with the same sprites as Point.
+ *
+ * Since there are no Point objects, the selection and marking state is kept here, in a BitSet for each flag.
+ *
+ * In the Curve::RenderTiled mode, the points are rasterized by a TileLayer on worker threads,
+ * and this item only draws the finished tiles.
+ * In the Curve::RenderDensity mode, it draws a DensityGrid of the points instead of their markers.
+ **/
+class ScatterItem : public PlotItem
+{
+public:
+    explicit ScatterItem(Curve* curve);
+    virtual ~ScatterItem();
+
+    virtual void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = 0);
+    virtual QRectF boundingRect() const;
+
+    /**
+     * Recomputes the bounding rectangle and resizes the state list after the curve's data,
+     * transformation or point size have changed
+     **/
+    void update_geometry();
+
+    Curve* curve() const;
+    int size() const;
+
+    /**
+     * @return the position of point @p index, in scene coordinates
+     **/
+    QPointF scene_position(int index) const;
+
+    Point::State state(int index) const;
+    
+    /**
+     * @return the bits of all the points for @p flag, which must be either Point::Selected or Point::Marked
+     **/
+    const BitSet& state_bits(Point::StateFlag flag) const;
+    
+    /**
+     * @return the indices of the points that have @p flag, in increasing order
+     **/
+    QVector<int> indices_with(Point::StateFlag flag) const;
+    void set_state(int index, Point::State state);
+    bool state_flag(int index, Point::StateFlag flag) const;
+    void set_state_flag(int index, Point::StateFlag flag, bool on);
+    void set_all_state_flags(Point::StateFlag flag, bool on);
+    
+    /**
+     * Sets or clears @p flag on all the points in @p indices at once, with a single repaint
+     **/
+    void set_state_flag(const QVector<int>& indices, Point::StateFlag flag, bool on);
+    void toggle_state_flag(const QVector<int>& indices, Point::StateFlag flag);
+    
+    /**
+     * @return a spatial index over the positions of the points in this item's coordinates, 
+     * which is rebuilt after the data or the transformation change
+     **/
+    const PointIndex& point_index();
+
+    /**
+     * Sets @p to_flag on every point that has @p from_flag, and clears @p from_flag on all points
+     **/
+    void move_state_flag(Point::StateFlag from_flag, Point::StateFlag to_flag);
+
+private:
+    /**
+     * Draws the visible points from the sprite atlas with a single call. 
+     * @return false if the atlas had to be refilled in the meantime, in which case nothing was drawn
+     **/
+    bool draw_fragments(QPainter* painter, const QTransform& t, const QRectF& visible);
+    void draw_pixmaps(QPainter* painter, const QTransform& t, const QRectF& visible);
+    void draw_density(QPainter* painter, const QTransform& t, const QRectF& visible);
+    
+    /**
+     * @return the curve's draw order, or 0 if the points should be drawn in their natural order
+     **/
+    const int* draw_order() const;
+    void changed();
+    BitSet& mutable_state_bits(Point::StateFlag flag);
+    
+    /**
+     * Tells the plot that @p flag changed on the points from @p first up to @p end, 
+     * or on the points where it now differs from @p before
+     **/
+    void record_change(Point::StateFlag flag, int first, int end);
+    void record_changes(Point::StateFlag flag, const BitSet& before);
+
+    Curve* m_curve;
+    BitSet m_selected;
+    BitSet m_marked;
+    QRectF m_bounding_rect;
+    TileLayer* m_tiles;
+    DensityGrid m_density;
+    PointIndex m_index;
+    bool m_index_valid;
+    QImage m_density_image;
+};
+
+#endif // SCATTERITEM_H
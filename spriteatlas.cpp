@@ -0,0 +1,164 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spriteatlas.h"
+
+#include <QtGui/QPainter>
+
+const int AtlasWidth = 1024;
+const int InitialAtlasHeight = 256;
+const int MaximumAtlasHeight = 4096;
+const int AtlasPixelBytes = 4;
+
+// Empty pixels between sprites, so that neighbours do not bleed into each other when scaled
+const int SpritePadding = 1;
+
+SpriteAtlas::SpriteAtlas() :
+    m_shelf_x(0),
+    m_shelf_y(0),
+    m_shelf_height(0),
+    m_generation(0)
+{
+}
+
+SpriteAtlas& SpriteAtlas::shared()
+{
+    static SpriteAtlas atlas;
+    return atlas;
+}
+
+QRect SpriteAtlas::sprite_rect(int symbol, const QColor& color, int size, Point::State state, bool transparent)
+{
+    const PointData key(size, symbol, color, state, transparent);
+    QHash<PointData, QRect>::const_iterator it = m_rects.constFind(key);
+    if (it != m_rects.constEnd())
+    {
+        return it.value();
+    }
+
+    const QPixmap sprite = Point::sprite(symbol, color, size, state, transparent);
+    QPoint position;
+    if (!allocate(sprite.size(), position))
+    {
+        // The atlas is full of sprites that are probably no longer used, so we start over
+        clear();
+        if (!allocate(sprite.size(), position))
+        {
+            return QRect();
+        }
+    }
+
+    QPainter painter(&m_pixmap);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawPixmap(position, sprite);
+    painter.end();
+
+    const QRect rect(position, sprite.size());
+    m_rects.insert(key, rect);
+    return rect;
+}
+
+bool SpriteAtlas::allocate(const QSize& size, QPoint& position)
+{
+    const int width = size.width() + SpritePadding;
+    const int height = size.height() + SpritePadding;
+    const int maximum = maximum_height(Point::cache_limit());
+    if (width > AtlasWidth || height > maximum)
+    {
+        return false;
+    }
+
+    if (m_shelf_x + width > AtlasWidth)
+    {
+        // Start a new shelf below the current one
+        m_shelf_y += m_shelf_height;
+        m_shelf_x = 0;
+        m_shelf_height = 0;
+    }
+
+    if (m_pixmap.isNull() || m_shelf_y + height > m_pixmap.height())
+    {
+        int new_height = m_pixmap.isNull() ? InitialAtlasHeight : m_pixmap.height();
+        while (new_height < m_shelf_y + height)
+        {
+            new_height *= 2;
+        }
+        if (new_height > maximum)
+        {
+            return false;
+        }
+
+        // Growing keeps the existing sprites at their place, so their rectangles stay valid
+        QPixmap pixmap(AtlasWidth, new_height);
+        pixmap.fill(Qt::transparent);
+        if (!m_pixmap.isNull())
+        {
+            QPainter painter(&pixmap);
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            painter.drawPixmap(0, 0, m_pixmap);
+        }
+        m_pixmap = pixmap;
+    }
+
+    position = QPoint(m_shelf_x, m_shelf_y);
+    m_shelf_x += width;
+    m_shelf_height = qMax(m_shelf_height, height);
+    return true;
+}
+
+const QPixmap& SpriteAtlas::pixmap() const
+{
+    return m_pixmap;
+}
+
+int SpriteAtlas::generation() const
+{
+    return m_generation;
+}
+
+int SpriteAtlas::bytes() const
+{
+    return m_pixmap.width() * m_pixmap.height() * qMax(1, m_pixmap.depth() / 8);
+}
+
+int SpriteAtlas::maximum_bytes(int budget)
+{
+    return AtlasWidth * maximum_height(budget) * AtlasPixelBytes;
+}
+
+int SpriteAtlas::maximum_height(int budget)
+{
+    // The atlas takes at most half of the budget, the rest is left for the individual sprites
+    int height = MaximumAtlasHeight;
+    while (height >= InitialAtlasHeight && AtlasWidth * height * AtlasPixelBytes > budget / 2)
+    {
+        height /= 2;
+    }
+    // If even the smallest atlas does not fit, the points are drawn one by one
+    return (height >= InitialAtlasHeight) ? height : 0;
+}
+
+void SpriteAtlas::clear()
+{
+    m_rects.clear();
+    m_pixmap = QPixmap();
+    m_shelf_x = 0;
+    m_shelf_y = 0;
+    m_shelf_height = 0;
+    ++m_generation;
+}
@@ -0,0 +1,81 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPRITEATLAS_H
+#define SPRITEATLAS_H
+
+#include "point.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QRect>
+#include <QtGui/QPixmap>
+
+/**
+ * @brief All the point sprites, packed into a single pixmap
+ *
+ * Sprites are rendered with Point::sprite() the first time they are requested, and placed
+ * into rows (shelves) of the atlas. Because every sprite lives in the same pixmap,
+ * any number of points can be drawn with a single QPainter::drawPixmapFragments() call.
+ *
+ * When the atlas is full, it first grows, and once it reaches its maximum size, it is cleared and refilled.
+ * The maximum size is taken from Point::cache_limit(), so the atlas stays within the sprite memory budget.
+ * generation() changes whenever that happens, because previously returned rectangles become invalid.
+ **/
+class SpriteAtlas
+{
+public:
+    SpriteAtlas();
+
+    /**
+     * @return the atlas shared by all the plots
+     **/
+    static SpriteAtlas& shared();
+
+    /**
+     * @return the rectangle in pixmap() that holds the sprite for the given properties, adding it if needed
+     **/
+    QRect sprite_rect(int symbol, const QColor& color, int size, Point::State state, bool transparent);
+
+    const QPixmap& pixmap() const;
+    int generation() const;
+
+    /**
+     * @return the memory taken by the atlas pixmap, in bytes
+     **/
+    int bytes() const;
+
+    /**
+     * @return the largest size the atlas may grow to, in bytes, with a sprite memory budget of @p budget bytes
+     **/
+    static int maximum_bytes(int budget);
+
+    void clear();
+
+private:
+    bool allocate(const QSize& size, QPoint& position);
+    static int maximum_height(int budget);
+
+    QPixmap m_pixmap;
+    QHash<PointData, QRect> m_rects;
+    int m_shelf_x;
+    int m_shelf_y;
+    int m_shelf_height;
+    int m_generation;
+};
+
+#endif // SPRITEATLAS_H
@@ -0,0 +1,258 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tilelayer.h"
+#include "scatteritem.h"
+
+#include <QtCore/QtConcurrentRun>
+#include <QtCore/QtConcurrentMap>
+#include <QtCore/qmath.h>
+#include <QtGui/QPainter>
+
+// The side of a tile, in pixels
+const int TileSize = 256;
+
+/**
+ * @brief Paints the points sorted into one tile
+ *
+ * Every tile is only written by its own painter, so all of them can be painted in parallel.
+ **/
+struct TilePainter
+{
+    TilePainter(const QVector<QPointF>& positions, const QVector<int>& sprite_index, const QVector<QImage>& sprites,
+                const QVector< QVector<int> >& bins, LayerTile* tiles, const UpdateToken& token)
+    : positions(positions), sprite_index(sprite_index), sprites(sprites), bins(bins), tiles(tiles), token(token) {}
+
+    void operator()(int index)
+    {
+        if (*token != 0)
+        {
+            return;
+        }
+        LayerTile& tile = tiles[index];
+        tile.image = QImage(tile.rect.size(), QImage::Format_ARGB32_Premultiplied);
+        tile.image.fill(Qt::transparent);
+        QPainter painter(&tile.image);
+        painter.translate(-tile.rect.topLeft());
+        // The points are in drawing order, so they overlap the same way as with the other render modes
+        foreach (int i, bins[index])
+        {
+            const QImage& sprite = sprites[sprite_index[i]];
+            const QPointF& pos = positions[i];
+            painter.drawImage(QPointF(pos.x() - 0.5*sprite.width(), pos.y() - 0.5*sprite.height()), sprite);
+        }
+    }
+
+private:
+    const QVector<QPointF>& positions;
+    const QVector<int>& sprite_index;
+    const QVector<QImage>& sprites;
+    const QVector< QVector<int> >& bins;
+    LayerTile* tiles;
+    UpdateToken token;
+};
+
+TileLayer::TileLayer(ScatterItem* item) : QObject(),
+    m_item(item),
+    m_dirty(true)
+{
+    QObject::connect(&m_watcher, SIGNAL(finished()), SLOT(tilesFinished()));
+}
+
+TileLayer::~TileLayer()
+{
+    cancel();
+}
+
+void TileLayer::draw(QPainter* painter, const QTransform& transform, const QSize& device_size)
+{
+    if (m_dirty || transform != m_transform || device_size != m_device_size)
+    {
+        start(transform, device_size);
+    }
+    if (m_tiles.isEmpty() || !m_transform.isInvertible())
+    {
+        return;
+    }
+
+    // Until the new tiles are ready, the old ones are stretched to match the current transformation
+    painter->save();
+    if (transform != m_transform)
+    {
+        painter->setTransform(m_transform.inverted() * transform);
+    }
+    const int n = m_tiles.size();
+    for (int i = 0; i < n; ++i)
+    {
+        painter->drawPixmap(m_tiles[i].first.topLeft(), m_tiles[i].second);
+    }
+    painter->restore();
+}
+
+void TileLayer::invalidate()
+{
+    cancel();
+    m_dirty = true;
+}
+
+void TileLayer::start(const QTransform& transform, const QSize& device_size)
+{
+    if (!m_dirty && m_watcher.isRunning() && transform == m_pending_transform && device_size == m_pending_size)
+    {
+        // The right tiles are already being rendered
+        return;
+    }
+    cancel();
+    m_token = UpdateToken(new QAtomicInt(0));
+    m_pending_transform = transform;
+    m_pending_size = device_size;
+    m_dirty = false;
+
+    const Curve* curve = m_item->curve();
+    LayerJob job;
+    job.data = curve->curve_data();
+    job.selected = m_item->state_bits(Point::Selected);
+    job.marked = m_item->state_bits(Point::Marked);
+    job.order = curve->draw_order();
+    job.color = curve->color();
+    job.size = curve->point_size();
+    job.symbol = curve->symbol();
+    job.transform = transform;
+    job.device_size = device_size;
+    job.token = m_token;
+    m_watcher.setFuture(QtConcurrent::run(&TileLayer::render, job));
+}
+
+void TileLayer::cancel()
+{
+    if (m_watcher.isRunning())
+    {
+        *m_token = 1;
+        m_watcher.cancel();
+    }
+}
+
+void TileLayer::tilesFinished()
+{
+    if (m_watcher.isCanceled() || *m_token != 0)
+    {
+        return;
+    }
+
+    // Pixmaps can only be created here, on the GUI thread
+    const QList<LayerTile> tiles = m_watcher.result();
+    m_tiles.clear();
+    foreach (const LayerTile& tile, tiles)
+    {
+        m_tiles << qMakePair(tile.rect, QPixmap::fromImage(tile.image));
+    }
+    m_transform = m_pending_transform;
+    m_device_size = m_pending_size;
+    m_item->update();
+}
+
+QList<LayerTile> TileLayer::render(const LayerJob& job)
+{
+    const CurveData& data = job.data;
+    const int n = qMin(data.size(), job.selected.size());
+    const int columns = (job.device_size.width() + TileSize - 1) / TileSize;
+    const int rows = (job.device_size.height() + TileSize - 1) / TileSize;
+    if (n == 0 || columns <= 0 || rows <= 0)
+    {
+        return QList<LayerTile>();
+    }
+
+    // Sort the visible points into the tiles they overlap, and render each sprite only once
+    const QRect device(QPoint(0, 0), job.device_size);
+    QHash<PointData, int> sprite_keys;
+    QVector<QImage> sprites;
+    QVector<QPointF> positions(n);
+    QVector<int> sprite_index(n, -1);
+    QVector< QVector<int> > bins(columns * rows);
+    const bool ordered = (job.order.size() == data.size() && job.selected.size() == data.size());
+    for (int k = 0; k < n; ++k)
+    {
+        if (k % 65536 == 0 && *job.token != 0)
+        {
+            return QList<LayerTile>();
+        }
+        const int i = ordered ? job.order[k] : k;
+        const QPointF pos = job.transform.map(data.point(i));
+        const int s = data.size_at(i, job.size);
+        const int ps = s + 4;
+        const QRect r = QRect(qFloor(pos.x() - 0.5*ps), qFloor(pos.y() - 0.5*ps), ps + 1, ps + 1) & device;
+        if (r.isEmpty())
+        {
+            continue;
+        }
+
+        Point::State state = Point::Normal;
+        if (job.selected.test(i))
+        {
+            state |= Point::Selected;
+        }
+        if (job.marked.test(i))
+        {
+            state |= Point::Marked;
+        }
+        const PointData key(s, data.symbol(i, job.symbol), data.color(i, job.color), state, true);
+        QHash<PointData, int>::const_iterator it = sprite_keys.constFind(key);
+        if (it == sprite_keys.constEnd())
+        {
+            it = sprite_keys.insert(key, sprites.size());
+            sprites << Point::render_sprite(key.symbol, key.color, key.size, state, true);
+        }
+        positions[i] = pos;
+        sprite_index[i] = it.value();
+
+        for (int row = r.top() / TileSize; row <= r.bottom() / TileSize; ++row)
+        {
+            for (int column = r.left() / TileSize; column <= r.right() / TileSize; ++column)
+            {
+                bins[row * columns + column] << i;
+            }
+        }
+    }
+
+    QVector<LayerTile> tiles(columns * rows);
+    QList<int> used;
+    for (int index = 0; index < tiles.size(); ++index)
+    {
+        if (!bins[index].isEmpty())
+        {
+            const int row = index / columns;
+            const int column = index % columns;
+            tiles[index].rect = QRect(column * TileSize, row * TileSize, TileSize, TileSize) & device;
+            used << index;
+        }
+    }
+    QtConcurrent::blockingMap(used, TilePainter(positions, sprite_index, sprites, bins, tiles.data(), job.token));
+    if (*job.token != 0)
+    {
+        return QList<LayerTile>();
+    }
+
+    QList<LayerTile> result;
+    foreach (int index, used)
+    {
+        result << tiles[index];
+    }
+    return result;
+}
+
+#include "tilelayer.moc"
@@ -0,0 +1,103 @@
+/*
+    This file is part of the plot module for Orange
+    Copyright (C) 2011  Miha Čančula <miha@noughmad.eu>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TILELAYER_H
+#define TILELAYER_H
+
+#include "curve.h"
+
+#include <QtCore/QObject>
+#include <QtCore/QFutureWatcher>
+#include <QtGui/QTransform>
+
+class ScatterItem;
+
+/**
+ * @brief One rendered part of a TileLayer, in device coordinates
+ **/
+struct LayerTile
+{
+    QRect rect;
+    QImage image;
+};
+
+/**
+ * @brief Everything a TileLayer needs to render its tiles, copied from the curve
+ **/
+struct LayerJob
+{
+    CurveData data;
+    BitSet selected;
+    BitSet marked;
+    QVector<int> order;
+    QColor color;
+    int size;
+    int symbol;
+    QTransform transform;
+    QSize device_size;
+    UpdateToken token;
+};
+
+/**
+ * @brief Rasterizes the points of a ScatterItem into tiles on worker threads
+ *
+ * The visible area is split into square tiles, and the points are sorted into the tiles they overlap.
+ * The tiles are then painted in parallel with QtConcurrent, using the same sprites as Point,
+ * so the GUI thread only has to draw the finished tiles.
+ *
+ * While new tiles are being rendered, the previous ones are drawn stretched to the current transformation.
+ **/
+class TileLayer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TileLayer(ScatterItem* item);
+    virtual ~TileLayer();
+
+    /**
+     * Draws the finished tiles with @p painter, which must be in device coordinates,
+     * and starts rendering new ones if they do not match @p transform and @p device_size.
+     **/
+    void draw(QPainter* painter, const QTransform& transform, const QSize& device_size);
+
+    /**
+     * Marks the tiles as out of date, because the data or the point styles have changed
+     **/
+    void invalidate();
+
+private slots:
+    void tilesFinished();
+
+private:
+    void start(const QTransform& transform, const QSize& device_size);
+    void cancel();
+    static QList<LayerTile> render(const LayerJob& job);
+
+    ScatterItem* m_item;
+    QList< QPair<QRect, QPixmap> > m_tiles;
+    QTransform m_transform;
+    QSize m_device_size;
+    bool m_dirty;
+
+    QFutureWatcher< QList<LayerTile> > m_watcher;
+    UpdateToken m_token;
+    QTransform m_pending_transform;
+    QSize m_pending_size;
+};
+
+#endif // TILELAYER_H
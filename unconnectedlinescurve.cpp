@@ -20,37 +20,18 @@
 #include <QtGui/QPen>
 #include <QtCore/QDebug>
 
-struct PointMapper
+static QPainterPath unconnected_lines_path(const CurveData& data, const QTransform& t)
 {
-    typedef QPointF result_type;
-    PointMapper(const QTransform& t) : t(t) {}
-    
-    QPointF operator()(const DataPoint& p)
+    // Every pair of consecutive points forms one line segment
+    QPainterPath path;
+    const int n = data.size() - 1;
+    for (int i = 0; i < n; i += 2)
     {
-        return t.map(p);
+        path.moveTo(t.map(data.point(i)));
+        path.lineTo(t.map(data.point(i+1)));
     }
-    
-    QTransform t;
-};
-
-struct PathReducer
-{
-    PathReducer() : closed(true) {}
-    void operator()(QPainterPath& path, const QPointF point)
-    {
-        if (closed)
-        {
-            path.moveTo(point);
-        }
-        else
-        {
-            path.lineTo(point);
-        }
-        closed = !closed;
-    }
-    
-    bool closed;
-};
+    return path;
+}
 
 UnconnectedLinesCurve::UnconnectedLinesCurve(QGraphicsItem* parent): Curve(parent)
 {
@@ -70,7 +51,7 @@ void UnconnectedLinesCurve::update_properties()
     cancel_all_updates();
     if (needs_update() & UpdatePosition)
     {
-        m_path_watcher->setFuture(QtConcurrent::mappedReduced<QPainterPath>(data(), PointMapper(graph_transform()), PathReducer(), QtConcurrent::OrderedReduce | QtConcurrent::SequentialReduce));
+        m_path_watcher->setFuture(QtConcurrent::run(unconnected_lines_path, curve_data(), graph_transform()));
     }
     if (needs_update() & UpdatePen)
     {   